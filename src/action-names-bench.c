@@ -0,0 +1,475 @@
+/*
+ * Replays a large audio_actions message, the way handle_action_message()
+ * and action_parser() walk it, resolving every action and argument name
+ * once with the old scan over the descriptor tables and once with the
+ * name switches. Both have to resolve every name the same way.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <dbus/dbus.h>
+
+#include "action-names.h"
+
+#define NCONTEXT  400       /* context variables in the transaction */
+#define NGROUP    24        /* volume_limit and audio_cork entries */
+#define NDEVICE   8         /* audio_mute entries */
+#define ROUNDS    200
+#define MAXNAME   4096
+
+/* the old dispatch: length, first and last character, then strcmp */
+#define NAME_KEY(l,f,t) (((uint32_t)(l) << 16) | ((uint32_t)(uint8_t)(f) << 8) | \
+                         (uint32_t)(uint8_t)(t))
+
+struct namedsc {
+    const char *name;
+    int         id;
+    uint32_t    key;
+};
+
+typedef int (*resolve_t)(int, const char *);
+
+static DBusMessage *build_message(void);
+static void  add_action(DBusMessageIter *, const char *, int, const char **,
+                        const char **);
+static void  add_args(DBusMessageIter *, const char **, const char **);
+static long  replay(DBusMessage *, resolve_t, resolve_t, int *, int *);
+static int   old_action(int, const char *);
+static int   old_argument(int, const char *);
+static int   new_action(int, const char *);
+static int   new_argument(int, const char *);
+static int   record_action(int, const char *);
+static int   record_argument(int, const char *);
+static uint32_t name_key(const char *);
+static const struct namedsc *scan(struct namedsc *, const char *);
+static double now(void);
+
+static struct namedsc actions[] = {
+    { "com.nokia.policy.audio_route" , pa_policy_action_id_audio_route , 0 },
+    { "com.nokia.policy.volume_limit", pa_policy_action_id_volume_limit, 0 },
+    { "com.nokia.policy.audio_cork"  , pa_policy_action_id_audio_cork  , 0 },
+    { "com.nokia.policy.audio_mute"  , pa_policy_action_id_audio_mute , 0 },
+    { "com.nokia.policy.context"     , pa_policy_action_id_context     , 0 },
+    {               NULL             , 0                               , 0 }
+};
+
+/* the argument table of each action, as the parsers have them */
+static struct namedsc route_args[] = {
+    { "type"  , pa_policy_argument_id_type  , 0 },
+    { "device", pa_policy_argument_id_device, 0 },
+    { "mode"  , pa_policy_argument_id_mode  , 0 },
+    { "hwid"  , pa_policy_argument_id_hwid  , 0 },
+    {  NULL   , 0                           , 0 }
+};
+static struct namedsc limit_args[] = {
+    { "group" , pa_policy_argument_id_group , 0 },
+    { "limit" , pa_policy_argument_id_limit , 0 },
+    {  NULL   , 0                           , 0 }
+};
+static struct namedsc cork_args[] = {
+    { "group" , pa_policy_argument_id_group , 0 },
+    { "cork"  , pa_policy_argument_id_cork  , 0 },
+    {  NULL   , 0                           , 0 }
+};
+static struct namedsc mute_args[] = {
+    { "device", pa_policy_argument_id_device, 0 },
+    { "mute"  , pa_policy_argument_id_mute  , 0 },
+    {  NULL   , 0                           , 0 }
+};
+static struct namedsc context_args[] = {
+    { "variable", pa_policy_argument_id_variable, 0 },
+    { "value"   , pa_policy_argument_id_value   , 0 },
+    {  NULL     , 0                             , 0 }
+};
+
+static struct namedsc *arguments[pa_policy_action_id_max] = {
+    [pa_policy_action_id_audio_route]  = route_args,
+    [pa_policy_action_id_volume_limit] = limit_args,
+    [pa_policy_action_id_audio_cork]   = cork_args,
+    [pa_policy_action_id_audio_mute]   = mute_args,
+    [pa_policy_action_id_context]      = context_args,
+};
+
+/* what the parsers' tables, indexed by argument id, have a descriptor for */
+static char accepts[pa_policy_action_id_max][pa_policy_argument_id_max];
+
+/* the names of one replay, in the order they were resolved */
+static struct {
+    const char *name;
+    int         action;         /* -1 for action names */
+}           names[MAXNAME];
+static int  nname;
+
+
+int main(int argc, char **argv)
+{
+    DBusMessage    *msg;
+    struct namedsc *dsc;
+    long            sum[2];
+    int             nact[2];
+    int             narg[2];
+    int             failed = 0;
+    int             round;
+    int             i;
+    double          start;
+    double          t[2] = { 0.0, 0.0 };
+
+    (void)argc;
+    (void)argv;
+
+    for (i = 0;  i < pa_policy_action_id_max;  i++) {
+        for (dsc = arguments[i];  dsc && dsc->name;  dsc++)
+            accepts[i][dsc->id] = true;
+    }
+
+    msg = build_message();
+
+    /* the same walk without any name resolution, to see what is left */
+    replay(msg, NULL, NULL, &nact[0], &narg[0]);
+
+    start = now();
+    for (round = 0;  round < ROUNDS;  round++)
+        replay(msg, NULL, NULL, &nact[0], &narg[0]);
+    t[0] = now() - start;
+
+    printf("audio_actions with %d actions and %d arguments, %d replays\n",
+           nact[0], narg[0], ROUNDS);
+    printf("  walk only:        %8.1f us per message\n", t[0] * 1e6 / ROUNDS);
+
+    start = now();
+    for (round = 0;  round < ROUNDS;  round++)
+        sum[0] = replay(msg, old_action, old_argument, &nact[0], &narg[0]);
+    t[0] = now() - start;
+
+    start = now();
+    for (round = 0;  round < ROUNDS;  round++)
+        sum[1] = replay(msg, new_action, new_argument, &nact[1], &narg[1]);
+    t[1] = now() - start;
+
+    printf("  table scan:       %8.1f us per message\n", t[0] * 1e6 / ROUNDS);
+    printf("  name switch:      %8.1f us per message\n", t[1] * 1e6 / ROUNDS);
+
+    if (sum[0] != sum[1] || nact[0] != nact[1] || narg[0] != narg[1]) {
+        printf("the scan and the switch resolved the names differently\n");
+        failed++;
+    }
+
+    /* the name resolution alone, without the message walk around it */
+    replay(msg, record_action, record_argument, &nact[0], &narg[0]);
+
+    sum[0] = sum[1] = 0;
+
+    start = now();
+    for (round = 0;  round < ROUNDS;  round++) {
+        for (i = 0;  i < nname;  i++) {
+            if (names[i].action < 0)
+                sum[0] += old_action(0, names[i].name);
+            else
+                sum[0] += old_argument(names[i].action, names[i].name);
+        }
+    }
+    t[0] = now() - start;
+
+    start = now();
+    for (round = 0;  round < ROUNDS;  round++) {
+        for (i = 0;  i < nname;  i++) {
+            if (names[i].action < 0)
+                sum[1] += new_action(0, names[i].name);
+            else
+                sum[1] += new_argument(names[i].action, names[i].name);
+        }
+    }
+    t[1] = now() - start;
+
+    printf("  %d names alone: %6.1f us with the scan, %6.1f us with the "
+           "switch\n", nname, t[0] * 1e6 / ROUNDS, t[1] * 1e6 / ROUNDS);
+
+    if (sum[0] != sum[1]) {
+        printf("the scan and the switch resolved the names differently\n");
+        failed++;
+    }
+
+    dbus_message_unref(msg);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/*
+ * A call setup transaction: a few routes, a limit and a cork for every
+ * group, a mute for some devices and a long list of context variables.
+ * An unknown action and an unknown argument are mixed in as well.
+ */
+static DBusMessage *build_message(void)
+{
+    static const char *route_names[]   = { "type", "device", "mode", "hwid", NULL };
+    static const char *limit_names[]   = { "group", "limit", NULL };
+    static const char *cork_names[]    = { "group", "cork", NULL };
+    static const char *mute_names[]    = { "device", "mute", NULL };
+    static const char *context_names[] = { "variable", "value", NULL };
+    static const char *extra_names[]   = { "variable", "value", "origin", NULL };
+    static const char *route_values[]  = { "sink", "earpiece", "voice", "0", NULL };
+
+    DBusMessage     *msg;
+    DBusMessageIter  msgit;
+    DBusMessageIter  arrit;
+    dbus_uint32_t    txid = 1;
+
+    msg = dbus_message_new_signal("/com/nokia/policy/decision",
+                                  "com.nokia.policy", "audio_actions");
+
+    dbus_message_iter_init_append(msg, &msgit);
+    dbus_message_iter_append_basic(&msgit, DBUS_TYPE_UINT32, &txid);
+    dbus_message_iter_open_container(&msgit, DBUS_TYPE_ARRAY, "{saa(sv)}",
+                                     &arrit);
+
+    add_action(&arrit, "com.nokia.policy.audio_route", 2,
+               route_names, route_values);
+    add_action(&arrit, "com.nokia.policy.volume_limit", NGROUP,
+               limit_names, NULL);
+    add_action(&arrit, "com.nokia.policy.audio_cork", NGROUP,
+               cork_names, NULL);
+    add_action(&arrit, "com.nokia.policy.audio_mute", NDEVICE,
+               mute_names, NULL);
+    add_action(&arrit, "com.nokia.policy.context", NCONTEXT,
+               context_names, NULL);
+    add_action(&arrit, "com.nokia.policy.context", 4,
+               extra_names, NULL);
+    add_action(&arrit, "com.nokia.policy.audio_dither", 2,
+               cork_names, NULL);
+
+    dbus_message_iter_close_container(&msgit, &arrit);
+
+    return msg;
+}
+
+static void add_action(DBusMessageIter *arrit, const char *name, int count,
+                       const char **names, const char **values)
+{
+    DBusMessageIter entit;
+    DBusMessageIter actit;
+    int             i;
+
+    dbus_message_iter_open_container(arrit, DBUS_TYPE_DICT_ENTRY, NULL,
+                                     &entit);
+    dbus_message_iter_append_basic(&entit, DBUS_TYPE_STRING, &name);
+    dbus_message_iter_open_container(&entit, DBUS_TYPE_ARRAY, "a(sv)",
+                                     &actit);
+
+    for (i = 0;  i < count;  i++)
+        add_args(&actit, names, values);
+
+    dbus_message_iter_close_container(&entit, &actit);
+    dbus_message_iter_close_container(arrit, &entit);
+}
+
+static void add_args(DBusMessageIter *actit, const char **names,
+                     const char **values)
+{
+    DBusMessageIter cmdit;
+    DBusMessageIter argit;
+    DBusMessageIter valit;
+    dbus_int32_t    limit = 50;
+    const char     *value;
+    int             i;
+
+    dbus_message_iter_open_container(actit, DBUS_TYPE_ARRAY, "(sv)", &cmdit);
+
+    for (i = 0;  names[i] != NULL;  i++) {
+        dbus_message_iter_open_container(&cmdit, DBUS_TYPE_STRUCT, NULL,
+                                         &argit);
+        dbus_message_iter_append_basic(&argit, DBUS_TYPE_STRING, &names[i]);
+
+        if (!strcmp(names[i], "limit")) {
+            dbus_message_iter_open_container(&argit, DBUS_TYPE_VARIANT, "i",
+                                             &valit);
+            dbus_message_iter_append_basic(&valit, DBUS_TYPE_INT32, &limit);
+        }
+        else {
+            value = values ? values[i] : "some-value";
+            dbus_message_iter_open_container(&argit, DBUS_TYPE_VARIANT, "s",
+                                             &valit);
+            dbus_message_iter_append_basic(&valit, DBUS_TYPE_STRING, &value);
+        }
+
+        dbus_message_iter_close_container(&argit, &valit);
+        dbus_message_iter_close_container(&cmdit, &argit);
+    }
+
+    dbus_message_iter_close_container(actit, &cmdit);
+}
+
+/*
+ * Walks the message like handle_action_message() and action_parser() do
+ * and fetches every argument value. Returns a sum of the resolved ids so
+ * the two resolvers can be compared.
+ */
+static long replay(DBusMessage *msg, resolve_t action, resolve_t argument,
+                   int *nact, int *narg)
+{
+    DBusMessageIter  msgit;
+    DBusMessageIter  arrit;
+    DBusMessageIter  entit;
+    DBusMessageIter  actit;
+    DBusMessageIter  cmdit;
+    DBusMessageIter  argit;
+    DBusMessageIter  valit;
+    dbus_uint32_t    txid;
+    char            *actname;
+    char            *argname;
+    const char      *strval;
+    long             sum = 0;
+    int              id;
+    int              argid;
+
+    *nact = *narg = 0;
+
+    dbus_message_iter_init(msg, &msgit);
+    dbus_message_iter_get_basic(&msgit, &txid);
+    dbus_message_iter_next(&msgit);
+    dbus_message_iter_recurse(&msgit, &arrit);
+
+    do {
+        dbus_message_iter_recurse(&arrit, &entit);
+        dbus_message_iter_get_basic(&entit, &actname);
+        dbus_message_iter_next(&entit);
+        dbus_message_iter_recurse(&entit, &actit);
+
+        id = action ? action(0, actname) : 0;
+        sum += id;
+
+        do {
+            dbus_message_iter_recurse(&actit, &cmdit);
+            (*nact)++;
+
+            do {
+                dbus_message_iter_recurse(&cmdit, &argit);
+                dbus_message_iter_get_basic(&argit, &argname);
+                dbus_message_iter_next(&argit);
+                dbus_message_iter_recurse(&argit, &valit);
+
+                if (id == 0 && action != NULL)
+                    continue;
+
+                (*narg)++;
+
+                argid = argument ? argument(id, argname) : 0;
+                sum += argid;
+
+                if (dbus_message_iter_get_arg_type(&valit) == DBUS_TYPE_STRING)
+                    dbus_message_iter_get_basic(&valit, &strval);
+
+            } while (dbus_message_iter_next(&cmdit));
+
+        } while (dbus_message_iter_next(&actit));
+
+    } while (dbus_message_iter_next(&arrit));
+
+    return sum;
+}
+
+static int old_action(int unused, const char *name)
+{
+    const struct namedsc *dsc = scan(actions, name);
+
+    (void)unused;
+
+    return dsc ? dsc->id : 0;
+}
+
+static int old_argument(int action, const char *name)
+{
+    const struct namedsc *dsc = scan(arguments[action], name);
+
+    return dsc ? dsc->id : 0;
+}
+
+static int new_action(int unused, const char *name)
+{
+    (void)unused;
+
+    return pa_policy_action_id(name);
+}
+
+static int new_argument(int action, const char *name)
+{
+    int id = pa_policy_argument_id(name);
+
+    return accepts[action][id] ? id : 0;
+}
+
+static int record_action(int unused, const char *name)
+{
+    (void)unused;
+
+    if (nname < MAXNAME) {
+        names[nname].name   = name;
+        names[nname].action = -1;
+        nname++;
+    }
+
+    return new_action(0, name);
+}
+
+static int record_argument(int action, const char *name)
+{
+    if (nname < MAXNAME) {
+        names[nname].name   = name;
+        names[nname].action = action;
+        nname++;
+    }
+
+    return new_argument(action, name);
+}
+
+static uint32_t name_key(const char *name)
+{
+    size_t len = strlen(name);
+
+    return len ? NAME_KEY(len, name[0], name[len-1]) : 0;
+}
+
+static const struct namedsc *scan(struct namedsc *descs, const char *name)
+{
+    struct namedsc *dsc;
+    uint32_t        key;
+
+    if (!descs->key) {
+        for (dsc = descs;  dsc->name != NULL;  dsc++)
+            dsc->key = name_key(dsc->name);
+    }
+
+    key = name_key(name);
+
+    for (dsc = descs;  dsc->name != NULL;  dsc++) {
+        if (dsc->key == key && !strcmp(name, dsc->name))
+            return dsc;
+    }
+
+    return NULL;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,105 @@
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "action-names.h"
+
+#define ACTION_PREFIX      "com.nokia.policy."
+#define ACTION_PREFIX_LEN  (sizeof(ACTION_PREFIX) - 1)
+
+
+static const char *action_names[pa_policy_action_id_max] = {
+    [pa_policy_action_id_unknown]      = "",
+    [pa_policy_action_id_audio_route]  = ACTION_PREFIX "audio_route",
+    [pa_policy_action_id_volume_limit] = ACTION_PREFIX "volume_limit",
+    [pa_policy_action_id_audio_cork]   = ACTION_PREFIX "audio_cork",
+    [pa_policy_action_id_audio_mute]   = ACTION_PREFIX "audio_mute",
+    [pa_policy_action_id_context]      = ACTION_PREFIX "context",
+};
+
+static const char *argument_names[pa_policy_argument_id_max] = {
+    [pa_policy_argument_id_unknown]  = "",
+    [pa_policy_argument_id_type]     = "type",
+    [pa_policy_argument_id_device]   = "device",
+    [pa_policy_argument_id_mode]     = "mode",
+    [pa_policy_argument_id_hwid]     = "hwid",
+    [pa_policy_argument_id_group]    = "group",
+    [pa_policy_argument_id_limit]    = "limit",
+    [pa_policy_argument_id_cork]     = "cork",
+    [pa_policy_argument_id_mute]     = "mute",
+    [pa_policy_argument_id_variable] = "variable",
+    [pa_policy_argument_id_value]    = "value",
+};
+
+
+/*
+ * The switches pick the only name a string can be, by its length and a
+ * character that tells the candidates apart. One strcmp confirms it.
+ */
+enum pa_policy_action_id pa_policy_action_id(const char *name)
+{
+    enum pa_policy_action_id id;
+
+    switch (strlen(name)) {
+    case ACTION_PREFIX_LEN + 11:    /* audio_route */
+        id = pa_policy_action_id_audio_route;
+        break;
+    case ACTION_PREFIX_LEN + 12:    /* volume_limit */
+        id = pa_policy_action_id_volume_limit;
+        break;
+    case ACTION_PREFIX_LEN + 10:    /* audio_cork, audio_mute */
+        if (name[ACTION_PREFIX_LEN + 6] == 'c')
+            id = pa_policy_action_id_audio_cork;
+        else
+            id = pa_policy_action_id_audio_mute;
+        break;
+    case ACTION_PREFIX_LEN + 7:     /* context */
+        id = pa_policy_action_id_context;
+        break;
+    default:
+        return pa_policy_action_id_unknown;
+    }
+
+    return strcmp(name, action_names[id]) ? pa_policy_action_id_unknown : id;
+}
+
+enum pa_policy_argument_id pa_policy_argument_id(const char *name)
+{
+    enum pa_policy_argument_id id;
+
+    switch (name[0]) {
+    case 't':   id = pa_policy_argument_id_type;    break;
+    case 'd':   id = pa_policy_argument_id_device;  break;
+    case 'h':   id = pa_policy_argument_id_hwid;    break;
+    case 'g':   id = pa_policy_argument_id_group;   break;
+    case 'l':   id = pa_policy_argument_id_limit;   break;
+    case 'c':   id = pa_policy_argument_id_cork;    break;
+    case 'm':   /* mode, mute */
+        if (name[1] == 'o')
+            id = pa_policy_argument_id_mode;
+        else
+            id = pa_policy_argument_id_mute;
+        break;
+    case 'v':   /* variable, value */
+        if (name[1] == 'a' && name[2] == 'r')
+            id = pa_policy_argument_id_variable;
+        else
+            id = pa_policy_argument_id_value;
+        break;
+    default:
+        return pa_policy_argument_id_unknown;
+    }
+
+    return strcmp(name, argument_names[id]) ? pa_policy_argument_id_unknown : id;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,47 @@
+#ifndef fooactionnamesfoo
+#define fooactionnamesfoo
+
+/* names of the policy actions and their arguments in audio_actions */
+
+enum pa_policy_action_id {
+    pa_policy_action_id_unknown = 0,
+
+    pa_policy_action_id_audio_route,
+    pa_policy_action_id_volume_limit,
+    pa_policy_action_id_audio_cork,
+    pa_policy_action_id_audio_mute,
+    pa_policy_action_id_context,
+
+    pa_policy_action_id_max
+};
+
+enum pa_policy_argument_id {
+    pa_policy_argument_id_unknown = 0,
+
+    pa_policy_argument_id_type,
+    pa_policy_argument_id_device,
+    pa_policy_argument_id_mode,
+    pa_policy_argument_id_hwid,
+    pa_policy_argument_id_group,
+    pa_policy_argument_id_limit,
+    pa_policy_argument_id_cork,
+    pa_policy_argument_id_mute,
+    pa_policy_argument_id_variable,
+    pa_policy_argument_id_value,
+
+    pa_policy_argument_id_max
+};
+
+enum pa_policy_action_id   pa_policy_action_id(const char *);
+enum pa_policy_argument_id pa_policy_argument_id(const char *);
+
+
+#endif /* fooactionnamesfoo */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -7,6 +7,7 @@
 #include <pulsecore/card.h>
 
 #include "card-ext.h"
+#include "index-hash.h"
 #include "classify.h"
 #include "context.h"
 
@@ -22,6 +23,11 @@ static pa_hook_result_t card_unlink(void *, void *, void *);
 static void handle_new_card(struct userdata *, struct pa_card *);
 static void handle_removed_card(struct userdata *, struct pa_card *);
 
+static void select_cards(struct userdata *, char *, struct pa_card **,
+                         struct pa_classify_card_data **);
+static pa_card_profile *pending_profile(struct pa_card *,
+                                        struct pa_classify_card_data *);
+
 
 struct pa_card_evsubscr *pa_card_ext_subscription(struct userdata *u)
 {
@@ -76,6 +82,18 @@ void pa_card_ext_discover(struct userdata *u)
         handle_new_card(u, card);
 }
 
+struct pa_card_ext *pa_card_ext_lookup(struct userdata *u, struct pa_card *card)
+{
+    struct pa_card_ext *ext;
+
+    pa_assert(u);
+    pa_assert(card);
+
+    ext = pa_index_hash_lookup(u->hcrd, card->index);
+
+    return ext;
+}
+
 const char *pa_card_ext_get_name(struct pa_card *card)
 {
     return card->name ? card->name : "<unknown>";
@@ -110,62 +128,117 @@ char **pa_card_ext_get_profiles(struct pa_card *card)
 
 int pa_card_ext_set_profile(struct userdata *u, char *type)
 {    
-    void            *state = NULL;
-    pa_idxset       *idxset;
     struct pa_card  *card;
     struct pa_classify_card_data *data;
     struct pa_classify_card_data *datas[2] = { NULL, NULL };
     struct pa_card  *cards[2] = { NULL, NULL };
-    int              priority;
     const char      *pn;
     const char      *cn;
-    pa_card_profile *ap;
     pa_card_profile *new_profile;
     int              sts;
     int              i;
 
     pa_assert(u);
     pa_assert(u->core);
-    pa_assert_se((idxset = u->core->cards));
 
     sts = 0;
 
-    while ((card = pa_idxset_iterate(idxset, &state, NULL)) != NULL) {
+    select_cards(u, type, cards, datas);
+
+    for (i = 0; i < 2 && datas[i]; i++) {
+
+        data = datas[i];
+        card = cards[i];
+
+        if (!(new_profile = pending_profile(card, data)))
+            continue;
+
+        pn = data->profile;
+        cn = pa_card_ext_get_name(card);
+
+        if (pa_card_set_profile(card, new_profile, false) < 0) {
+            sts = -1;
+            pa_log("failed to set card '%s' profile to '%s'", cn, pn);
+        }
+        else
+            pa_log_debug("changed card '%s' profile to '%s'", cn, pn);
+    }
+
+    return sts;
+}
+
+/*
+ * collect the cards whose profile pa_card_ext_set_profile() would
+ * change for the given type; returns the number of cards added
+ */
+int pa_card_ext_profile_pending(struct userdata *u, char *type,
+                                pa_idxset *pending)
+{
+    struct pa_classify_card_data *datas[2] = { NULL, NULL };
+    struct pa_card  *cards[2] = { NULL, NULL };
+    int              cnt;
+    int              i;
+
+    pa_assert(u);
+    pa_assert(pending);
+
+    select_cards(u, type, cards, datas);
+
+    for (i = cnt = 0; i < 2 && datas[i]; i++) {
+        if (pending_profile(cards[i], datas[i]) &&
+            pa_idxset_put(pending, cards[i], NULL) >= 0)
+            cnt++;
+    }
+
+    return cnt;
+}
+
+static void select_cards(struct userdata              *u,
+                         char                         *type,
+                         struct pa_card              **cards,
+                         struct pa_classify_card_data **datas)
+{
+    pa_idxset       *cardset;
+    struct pa_card  *card;
+    struct pa_classify_card_data *data;
+    int              priority;
+    uint32_t         idx;
+
+    if (!(cardset = pa_classify_type_members(u, type, pa_classify_member_card)))
+        return;
+
+    /* of several matching cards the one with the highest index wins,
+       like the last one would when iterating over all the cards */
+    PA_IDXSET_FOREACH(card, cardset, idx) {
         if (pa_classify_is_card_typeof(u, card, type, &data, &priority)) {
-            if (priority == 0) {
+            if (priority == 0 && (!cards[0] || card->index > cards[0]->index)) {
                 datas[0] = data;
                 cards[0] = card;
             }
-            if (priority == 1) {
+            if (priority == 1 && (!cards[1] || card->index > cards[1]->index)) {
                 datas[1] = data;
                 cards[1] = card;
             }
         }
     }
+}
 
-    for (i = 0; i < 2 && datas[i]; i++) {
+static pa_card_profile *pending_profile(struct pa_card               *card,
+                                        struct pa_classify_card_data *data)
+{
+    pa_card_profile *ap;
+    pa_card_profile *new_profile;
 
-        data = datas[i];
-        card = cards[i];
+    if (!data->profile)
+        return NULL;
 
-        ap = card->active_profile;
-        pn = data->profile;
-        if (!pn)
-            continue;
-        new_profile = pa_hashmap_get(card->profiles, pn);
-        cn = pa_card_ext_get_name(card);
+    ap = card->active_profile;
+    new_profile = pa_hashmap_get(card->profiles, data->profile);
 
-        if (new_profile && (!ap || ap != new_profile)) {
-            if (pa_card_set_profile(card, new_profile, false) < 0) {
-                sts = -1;
-                pa_log("failed to set card '%s' profile to '%s'", cn, pn);
-            }
-            else
-                pa_log_debug("changed card '%s' profile to '%s'", cn, pn);
-        }
-    }
+    if (new_profile && (!ap || ap != new_profile))
+        return new_profile;
 
-    return sts;
+    return NULL;
 }
 
 static pa_hook_result_t card_put(void *hook_data, void *call_data,
@@ -196,37 +269,42 @@ static void handle_new_card(struct userdata *u, struct pa_card *card)
 {
     const char *name;
     uint32_t  idx;
-    char      buf[1024];
-    int       len;
+    char     *typelist;
     int       ret;
+    struct pa_card_ext         *ext;
+    struct pa_classify_typeset *ts;
 
     if (card && u) {
         name = pa_card_ext_get_name(card);
         idx  = card->index;
-        len  = pa_classify_card(u, card, 0,0, buf, sizeof(buf));
+        ts   = pa_classify_card(u, card);
 
         pa_policy_context_register(u, pa_policy_object_card, name, card);
 
-        if (len <= 0)
+        ext = pa_xnew0(struct pa_card_ext, 1);
+        ext->typeset = ts;
+        pa_index_hash_add(u->hcrd, idx, ext);
+        pa_classify_index_card(u, card, ts);
+
+        if (pa_classify_typeset_empty(ts))
             pa_log_debug("new card '%s' (idx=%d)", name, idx);
         else {
+            typelist = pa_classify_typeset_string(u, ts);
             ret = pa_proplist_sets(card->proplist,
-                                   PA_PROP_POLICY_CARDTYPELIST, buf);
+                                   PA_PROP_POLICY_CARDTYPELIST, typelist);
 
             if (ret < 0) {
                 pa_log("failed to set property '%s' on card '%s'",
-                       PA_PROP_POLICY_DEVTYPELIST, name);
+                       PA_PROP_POLICY_CARDTYPELIST, name);
             }
             else {
                 pa_log_debug("new card '%s' (idx=%d) (type %s)",
-                             name, idx, buf);
-                
-                len = pa_classify_card(u, card, PA_POLICY_DISABLE_NOTIFY, 0,
-                                       buf, sizeof(buf));
-                if (len > 0) {
-                    pa_policy_send_device_state(u, PA_POLICY_CONNECTED, buf);
-                }
+                             name, idx, typelist);
+
+                pa_policy_send_device_state(u, PA_POLICY_CONNECTED, ts);
             }
+
+            pa_xfree(typelist);
         }
     }
 }
@@ -234,28 +312,40 @@ static void handle_new_card(struct userdata *u, struct pa_card *card)
 static void handle_removed_card(struct userdata *u, struct pa_card *card)
 {
     const char *name;
+    const char *typelist;
     uint32_t  idx;
-    char      buf[1024];
-    int       len;
+    struct pa_card_ext         *ext;
+    struct pa_classify_typeset *ts;
 
     if (card && u) {
         name = pa_card_ext_get_name(card);
         idx  = card->index;
-        len  = pa_classify_card(u, card, 0,0, buf, sizeof(buf));
 
         pa_policy_context_unregister(u, pa_policy_object_card, name, card,idx);
 
-        if (len <= 0)
+        pa_classify_unindex_card(u, card);
+
+        if ((ext = pa_index_hash_remove(u->hcrd, idx)) == NULL)
+            ts = pa_classify_card(u, card);
+        else {
+            ts = ext->typeset;
+            pa_xfree(ext);
+        }
+
+        if (pa_classify_typeset_empty(ts))
             pa_log_debug("remove card '%s' (idx=%d)", name, idx);
         else {
-            pa_log_debug("remove card '%s' (idx=%d, type=%s)", name,idx, buf);
-            
-            len = pa_classify_card(u, card, PA_POLICY_DISABLE_NOTIFY, 0,
-                                   buf, sizeof(buf));
-            if (len > 0) {
-                pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, buf);
-            }
+            if (!(typelist = pa_proplist_gets(card->proplist,
+                                              PA_PROP_POLICY_CARDTYPELIST)))
+                typelist = "";
+
+            pa_log_debug("remove card '%s' (idx=%d, type=%s)",
+                         name, idx, typelist);
+
+            pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, ts);
         }
+
+        pa_classify_typeset_free(ts);
     }
 }
 
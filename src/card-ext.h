@@ -3,17 +3,25 @@
 
 #include "userdata.h"
 
+struct pa_classify_typeset;
+
 struct pa_card_evsubscr {
     pa_hook_slot    *put;
     pa_hook_slot    *unlink;
 };
 
+struct pa_card_ext {
+    struct pa_classify_typeset *typeset;
+};
+
 struct pa_card_evsubscr *pa_card_ext_subscription(struct userdata *);
 void pa_card_ext_subscription_free(struct pa_card_evsubscr *);
 void pa_card_ext_discover(struct userdata *);
+struct pa_card_ext *pa_card_ext_lookup(struct userdata *, struct pa_card *);
 const char *pa_card_ext_get_name(struct pa_card *);
 char **pa_card_ext_get_profiles(struct pa_card *);
 int pa_card_ext_set_profile(struct userdata *, char *);
+int pa_card_ext_profile_pending(struct userdata *, char *, pa_idxset *);
 
 #endif
 
@@ -0,0 +1,205 @@
+/*
+ * Compares the precompiled 'matches' matcher with the plain regexec()
+ * evaluation it replaced, on synthetic rules of the shapes policy
+ * configurations use: anchored literals, literal prefixes followed by a
+ * wildcard or a bracket expression, and patterns with subexpressions.
+ * Every string is run through both, and any disagreement is a failure.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <regex.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "classify-regex.h"
+
+#define ROUNDS  20000
+
+static int    old_match(regex_t *, const char *);
+static double now(void);
+
+
+int main(int argc, char **argv)
+{
+    static const char *patterns[] = {
+        /* anchored literals */
+        "^alsa_output.platform-soc_audio.analog-stereo$",
+        "com.nokia.voicecall",
+        "^player$",
+        /* literal prefixes */
+        "alsa_output.usb-.*",
+        "bluez_sink.[0-9A-F_]*",
+        "^ringtone-[a-z]*$",
+        "pulsecore.*\\.so",
+        /* no prefix at all */
+        ".*-monitor",
+        "[a-z]*player",
+        /* subexpressions keep the submatch check */
+        "\\(alsa\\|bluez\\)_output.*",
+        "sink\\.\\(hw\\)*"
+    };
+
+    static const char *strings[] = {
+        "alsa_output.platform-soc_audio.analog-stereo",
+        "alsa_output.platform-soc_audio.analog-stereo.monitor",
+        "alsa_output.usb-0d8c_C-Media_USB_Audio-00.analog-stereo",
+        "alsa_input.platform-soc_audio.analog-mono",
+        "bluez_sink.00_1A_7D_DA_71_13",
+        "bluez_sink.00_1a_7d_da_71_13",
+        "bluez_source.00_1A_7D_DA_71_13",
+        "com.nokia.voicecall",
+        "com.nokia.voicecall.ui",
+        "org.freedesktop.Telepathy",
+        "player",
+        "mediaplayer",
+        "ringtone-default",
+        "ringtone-Default",
+        "pulsecore-6.0.so",
+        "null-sink-monitor",
+        "sink.hwhw",
+        "",
+        "x"
+    };
+
+    enum { NPATTERN = sizeof(patterns) / sizeof(patterns[0]) };
+    enum { NSTRING  = sizeof(strings)  / sizeof(strings[0])  };
+
+    struct pa_classify_regex re[NPATTERN];
+    regex_t                  old[NPATTERN];
+    int                      failed = 0;
+    int                      hits = 0;
+    int                      sink = 0;
+    int                      round;
+    int                      i, j;
+    double                   start;
+    double                   t_old;
+    double                   t_new;
+
+    (void)argc;
+    (void)argv;
+
+    for (i = 0;  i < NPATTERN;  i++) {
+        if (regcomp(&old[i], patterns[i], 0) != 0 ||
+            pa_classify_regex_compile(&re[i], patterns[i]) != 0)
+        {
+            printf("can't compile '%s'\n", patterns[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0;  i < NPATTERN;  i++) {
+        for (j = 0;  j < NSTRING;  j++) {
+            if (old_match(&old[i], strings[j]) !=
+                pa_classify_regex_match(&re[i], strings[j]))
+            {
+                printf("'%s' on '%s': old and new matcher disagree\n",
+                       patterns[i], strings[j]);
+                failed++;
+            }
+
+            hits += old_match(&old[i], strings[j]);
+        }
+    }
+
+    start = now();
+    for (round = 0;  round < ROUNDS;  round++) {
+        for (i = 0;  i < NPATTERN;  i++) {
+            for (j = 0;  j < NSTRING;  j++)
+                sink += old_match(&old[i], strings[j]);
+        }
+    }
+    t_old = now() - start;
+
+    start = now();
+    for (round = 0;  round < ROUNDS;  round++) {
+        for (i = 0;  i < NPATTERN;  i++) {
+            for (j = 0;  j < NSTRING;  j++)
+                sink += pa_classify_regex_match(&re[i], strings[j]);
+        }
+    }
+    t_new = now() - start;
+
+    printf("%d patterns x %d strings (%d matches), %d rounds\n",
+           NPATTERN, NSTRING, hits, ROUNDS);
+    printf("  regexec + full match check: %7.1f ns per evaluation\n",
+           t_old * 1e9 / ((double)ROUNDS * NPATTERN * NSTRING));
+    printf("  precompiled matcher:        %7.1f ns per evaluation\n",
+           t_new * 1e9 / ((double)ROUNDS * NPATTERN * NSTRING));
+
+    for (i = 0;  i < NPATTERN;  i++) {
+        start = now();
+        for (round = 0;  round < ROUNDS;  round++) {
+            for (j = 0;  j < NSTRING;  j++)
+                sink += old_match(&old[i], strings[j]);
+        }
+        t_old = now() - start;
+
+        start = now();
+        for (round = 0;  round < ROUNDS;  round++) {
+            for (j = 0;  j < NSTRING;  j++)
+                sink += pa_classify_regex_match(&re[i], strings[j]);
+        }
+        t_new = now() - start;
+
+        printf("    %-48s %7.1f -> %7.1f ns\n", patterns[i],
+               t_old * 1e9 / ((double)ROUNDS * NSTRING),
+               t_new * 1e9 / ((double)ROUNDS * NSTRING));
+    }
+
+    for (i = 0;  i < NPATTERN;  i++) {
+        regfree(&old[i]);
+        pa_classify_regex_free(&re[i]);
+    }
+
+    /* each of the four loops counted every match once */
+    if (sink != hits * ROUNDS * 4)
+        failed++;
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* the evaluation before the matcher was precompiled */
+static int old_match(regex_t *rexp, const char *string)
+{
+#define MAX_MATCH 5
+
+    regmatch_t m[MAX_MATCH];
+    regoff_t   end;
+    int        found;
+
+    found = false;
+
+    if (regexec(rexp, string, MAX_MATCH, m, 0) == 0) {
+        end = strlen(string);
+
+        if (m[0].rm_so == 0 && m[0].rm_eo == end && m[1].rm_so == -1)
+            found = true;
+    }
+
+    return found;
+
+#undef MAX_MATCH
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/strbuf.h>
+
+#include "classify-regex.h"
+
+
+/*
+ * Compile a 'matches' argument. The regexp has to match the whole string,
+ * so the literal characters it starts with can reject most strings without
+ * calling regexec(). A regexp without any metacharacters is handled as a
+ * plain string compare. A regexp without subexpressions is compiled with
+ * explicit anchors and REG_NOSUB, so regexec() does not need to track
+ * submatches. Regexps with subexpressions keep the original evaluation.
+ */
+int pa_classify_regex_compile(struct pa_classify_regex *re, const char *pattern)
+{
+    regex_t     probe;
+    pa_strbuf  *buf;
+    const char *p;
+    const char *next;
+    char       *anchored;
+    size_t      len;
+    size_t      i;
+    char        c;
+    int         alt;
+    int         sts;
+
+    pa_assert(re);
+    pa_assert(pattern);
+
+    memset(re, 0, sizeof(*re));
+
+    if (regcomp(&probe, pattern, 0) != 0)
+        return -1;
+
+    /* GNU alternation makes any prefix optional */
+    for (p = pattern, alt = false;  *p && !alt;  p++) {
+        if (p[0] == '\\' && p[1])
+            alt = (*++p == '|');
+    }
+
+    buf = pa_strbuf_new();
+
+    for (p = (pattern[0] == '^') ? pattern + 1 : pattern;  *p && !alt;  p = next) {
+        if (p[0] == '\\' && p[1] && strchr(".[]*^$\\", p[1])) {
+            c    = p[1];
+            next = p + 2;
+        }
+        else if (strchr(".[]*^$\\", p[0]))
+            break;
+        else {
+            c    = p[0];
+            next = p + 1;
+        }
+
+        /* the character is optional if it is repeated */
+        if (next[0] == '*' || (next[0] == '\\' && next[1] && strchr("{?+", next[1])))
+            break;
+
+        pa_strbuf_putc(buf, c);
+    }
+
+    re->prefix     = pa_strbuf_tostring_free(buf);
+    re->prefix_len = strlen(re->prefix);
+
+    if (*p == '\0') {
+        re->flags |= PA_POLICY_REGEX_LITERAL;
+        re->rexp   = probe;
+        return 0;
+    }
+
+    if (probe.re_nsub == 0 && !alt) {
+        /* a trailing '$' is an anchor unless it is escaped */
+        for (len = strlen(pattern), i = len - 1;  i > 0;  i--) {
+            if (pattern[i-1] != '\\')
+                break;
+        }
+
+        anchored = pa_sprintf_malloc("%s%s%s",
+                                     pattern[0] == '^' ? "" : "^", pattern,
+                                     (pattern[len-1] == '$' &&
+                                      ((len - 1 - i) % 2) == 0) ? "" : "$");
+
+        sts = regcomp(&re->rexp, anchored, REG_NOSUB);
+
+        pa_xfree(anchored);
+
+        if (sts == 0) {
+            re->flags |= PA_POLICY_REGEX_ANCHORED;
+            regfree(&probe);
+            return 0;
+        }
+    }
+
+    re->rexp = probe;
+
+    return 0;
+}
+
+void pa_classify_regex_free(struct pa_classify_regex *re)
+{
+    pa_assert(re);
+
+    regfree(&re->rexp);
+    pa_xfree(re->prefix);
+
+    memset(re, 0, sizeof(*re));
+}
+
+/*
+ * True if the regexp matches the whole string. A regexp with
+ * subexpressions also requires the first one not to take part.
+ */
+int pa_classify_regex_match(struct pa_classify_regex *re, const char *string)
+{
+#define MAX_MATCH 5
+
+    regmatch_t m[MAX_MATCH];
+    int        found;
+
+    found = false;
+
+    if (string && re) {
+        if (re->prefix_len && strncmp(string, re->prefix, re->prefix_len))
+            found = false;
+        else if ((re->flags & PA_POLICY_REGEX_LITERAL))
+            found = (string[re->prefix_len] == '\0');
+        else if ((re->flags & PA_POLICY_REGEX_ANCHORED))
+            found = (regexec(&re->rexp, string, 0, NULL, 0) == 0);
+        else if (regexec(&re->rexp, string, MAX_MATCH, m, 0) == 0) {
+            if (m[0].rm_so == 0 && string[m[0].rm_eo] == '\0' &&
+                m[1].rm_so == -1)
+                found = true;
+        }
+    }
+
+    return found;
+
+#undef MAX_MATCH
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
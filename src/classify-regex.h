@@ -0,0 +1,31 @@
+#ifndef fooclassifyregexfoo
+#define fooclassifyregexfoo
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <regex.h>
+
+#define PA_POLICY_REGEX_LITERAL   (1UL << 0) /* no metacharacters at all */
+#define PA_POLICY_REGEX_ANCHORED  (1UL << 1) /* compiled as ^...$, no subexp */
+
+struct pa_classify_regex {
+    regex_t     rexp;
+    char       *prefix;     /* literal every match starts with */
+    size_t      prefix_len;
+    uint32_t    flags;      /* PA_POLICY_REGEX_xxx */
+};
+
+int   pa_classify_regex_compile(struct pa_classify_regex *, const char *);
+void  pa_classify_regex_free(struct pa_classify_regex *);
+int   pa_classify_regex_match(struct pa_classify_regex *, const char *);
+
+
+#endif /* fooclassifyregexfoo */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
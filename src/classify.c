@@ -28,53 +28,120 @@ static const char *find_group_for_client(struct userdata *, struct pa_client *,
 static char *arg_dump(int, char **, char *, size_t);
 #endif
 
-static void  pid_hash_free(struct pa_classify_pid_hash **);
-static void  pid_hash_insert(struct pa_classify_pid_hash **, pid_t,
+static void  pid_hash_insert(struct pa_classify_pid_table *, pid_t,
                              const char *, enum pa_classify_method,
                              const char *, const char *);
-static void  pid_hash_remove(struct pa_classify_pid_hash **, pid_t,
+static void  pid_hash_remove(struct pa_classify_pid_table *, pid_t,
                              const char *, enum pa_classify_method,
                              const char *);
-static char *pid_hash_get_group(struct pa_classify_pid_hash **, pid_t,
+static char *pid_hash_get_group(struct pa_classify_pid_table *, pid_t,
                                 pa_proplist *);
-static struct pa_classify_pid_hash
-            *pid_hash_find(struct pa_classify_pid_hash **, pid_t,
-                           const char *, enum pa_classify_method, const char *,
-                           struct pa_classify_pid_hash **);
-
-static void streams_free(struct pa_classify_stream_def *);
-static void streams_add(struct pa_classify_stream_def **, const char *,
+static void  pid_hash_free_rules(struct pa_classify_pid_hash *);
+static struct pa_classify_pid_rule
+            *pid_rule_find(struct pa_classify_pid_hash *, const char *,
+                           enum pa_classify_method, const char *,
+                           struct pa_classify_pid_rule ***);
+static void  pid_rule_free(struct pa_classify_pid_rule *);
+
+static void  cache_init(struct pa_classify_cache *);
+static void  cache_free(struct pa_classify_cache *);
+static void  cache_flush(struct pa_classify_cache *, const char *);
+static void  cache_add_property(struct pa_classify_cache *, const char *);
+static int   cache_key(struct pa_classify_cache *, pid_t, uid_t, const char *,
+                       const char *, pa_proplist *, char *, size_t);
+static struct pa_classify_cache_entry
+            *cache_lookup(struct pa_classify_cache *, const char *);
+static struct pa_classify_cache_entry
+            *cache_add(struct pa_classify_cache *, const char *, const char *,
+                       uint32_t);
+static void  cache_entry_free(struct pa_classify_cache_entry *);
+
+static void streams_init(struct pa_classify_stream *);
+static void streams_free(struct pa_classify_stream *);
+static void streams_add(struct pa_classify_stream *, const char *,
                         enum pa_classify_method, const char *, const char *,
                         const char *, uid_t, const char *, const char *, uint32_t);
-static const char *streams_get_group(struct pa_classify_stream_def **, pa_proplist *,
+static const char *streams_get_group(struct pa_classify_stream *, pa_proplist *,
                                      const char *, uid_t, const char *, uint32_t *);
 static struct pa_classify_stream_def
-            *streams_find(struct pa_classify_stream_def **, pa_proplist *,
-                          const char *, const char *, uid_t, const char *,
-                          struct pa_classify_stream_def **);
+            *streams_find(struct pa_classify_stream *, pa_proplist *,
+                          const char *, const char *, uid_t, const char *);
+static void streams_index_add(struct pa_classify_stream_index *,
+                              struct pa_classify_stream_def *,
+                              enum pa_classify_method);
+static struct pa_classify_stream_bucket
+            *stream_bucket_get(pa_hashmap *, const char *, int);
+static void stream_bucket_free(struct pa_classify_stream_bucket *);
+static void stream_propidx_free(struct pa_classify_stream_propidx *);
+static struct pa_classify_stream_def
+            *stream_bucket_find(struct pa_classify_stream_bucket *,
+                                struct pa_classify_stream_def *,
+                                pa_proplist *, const char *, const char *,
+                                uid_t, const char *);
+static int stream_def_matches(struct pa_classify_stream_def *, pa_proplist *,
+                              const char *, const char *, uid_t, const char *);
+static const char *stream_property(const char *, pa_proplist *);
+
+static void types_init(struct pa_classify_types *);
+static void types_free(struct pa_classify_types *);
+static uint32_t types_intern(struct pa_classify_types *, const char *);
+static int  types_lookup(struct pa_classify_types *, const char *, uint32_t *);
+static void types_add_member(struct pa_classify_types *, uint32_t,
+                             enum pa_classify_member, void *);
+static void types_index(struct pa_classify_types *, enum pa_classify_member,
+                        struct pa_classify_typeset *, void *);
+static void types_unindex(struct pa_classify_types *, enum pa_classify_member,
+                          void *);
+static void types_index_ports(struct pa_classify_types *,
+                              struct pa_classify_device *,
+                              enum pa_classify_member, const char *, void *);
+
+static struct pa_classify_typeset *typeset_new(uint32_t, uint32_t);
+static void typeset_set(uint32_t *, uint32_t);
+static int  typeset_test(struct pa_classify_typeset *, uint32_t *, uint32_t);
 
 static void devices_free(struct pa_classify_device *);
-static void devices_add(struct pa_classify_device **, const char *,
-                        const char *,  enum pa_classify_method, const char *, pa_hashmap *,
-                        uint32_t);
-static int devices_classify(struct pa_classify_device_def *, pa_proplist *,
-                            const char *, uint32_t, uint32_t, char *, int);
+static void devices_add(struct pa_classify_device **, struct pa_classify_types *,
+                        const char *, const char *,  enum pa_classify_method,
+                        const char *, pa_hashmap *, uint32_t);
+static struct pa_classify_typeset
+            *devices_classify(struct pa_classify_device *,
+                              struct pa_classify_types *, pa_proplist *,
+                              const char *);
 static int devices_is_typeof(struct pa_classify_device_def *, pa_proplist *,
                              const char *, const char *,
                              struct pa_classify_device_data **);
+static int devices_typeset_is_typeof(struct pa_classify_device_def *,
+                                     struct pa_classify_types *,
+                                     struct pa_classify_typeset *, const char *,
+                                     struct pa_classify_device_data **);
 
 static void cards_free(struct pa_classify_card *);
-static void cards_add(struct pa_classify_card **, char *,
-                      enum pa_classify_method[2], char **, char **, uint32_t[2]);
-static int  cards_classify(struct pa_classify_card_def *, const char *, char **,
-                           uint32_t,uint32_t, char *,int);
+static void cards_add(struct pa_classify_card **, struct pa_classify_types *,
+                      char *, enum pa_classify_method[2], char **, char **,
+                      uint32_t[2]);
+static struct pa_classify_typeset
+            *cards_classify(struct pa_classify_card *,
+                            struct pa_classify_types *, const char *, char **);
 static int card_is_typeof(struct pa_classify_card_def *, const char *,
                           const char *, struct pa_classify_card_data **, int *priority);
+static int card_typeset_is_typeof(struct pa_classify_card_def *,
+                                  struct pa_classify_types *,
+                                  struct pa_classify_typeset *, const char *,
+                                  struct pa_classify_card_data **, int *);
 
 static int port_device_is_typeof(struct pa_classify_device_def *, const char *,
                                  const char *,
                                  struct pa_classify_device_data **);
 
+static struct pa_classify_trie *trie_new(char);
+static void trie_free(struct pa_classify_trie *);
+static void trie_insert(struct pa_classify_trie *, const char *, void *);
+static struct pa_classify_trie *trie_child(struct pa_classify_trie *, char);
+static pa_hashmap *prefixes_new(void);
+static struct pa_classify_prefix *prefixes_get(pa_hashmap *, const char *);
+static void prefix_free(struct pa_classify_prefix *);
+
 static const char *method_str(enum pa_classify_method);
 
 const char *get_property(const char *, pa_proplist *, const char *);
@@ -87,6 +154,11 @@ struct pa_classify *pa_classify_new(struct userdata *u)
 
     cl = pa_xnew0(struct pa_classify, 1);
 
+    types_init(&cl->types);
+    pa_pid_hash_init(&cl->streams.pid_hash);
+    streams_init(&cl->streams);
+    cache_init(&cl->cache);
+
     cl->sinks   = pa_xnew0(struct pa_classify_device, 1);
     cl->sources = pa_xnew0(struct pa_classify_device, 1);
     cl->cards   = pa_xnew0(struct pa_classify_card, 1);
@@ -97,11 +169,13 @@ struct pa_classify *pa_classify_new(struct userdata *u)
 void pa_classify_free(struct pa_classify *cl)
 {
     if (cl) {
-        pid_hash_free(cl->streams.pid_hash);
-        streams_free(cl->streams.defs);
+        pa_pid_hash_free(&cl->streams.pid_hash, pid_hash_free_rules);
+        streams_free(&cl->streams);
         devices_free(cl->sinks);
         devices_free(cl->sources);
         cards_free(cl->cards);
+        cache_free(&cl->cache);
+        types_free(&cl->types);
 
         pa_xfree(cl);
     }
@@ -120,7 +194,7 @@ void pa_classify_add_sink(struct userdata *u, const char *type, const char *prop
     pa_assert(prop);
     pa_assert(arg);
 
-    devices_add(&classify->sinks, type, prop, method, arg, ports, flags);
+    devices_add(&classify->sinks, &classify->types, type, prop, method, arg, ports, flags);
 }
 
 void pa_classify_add_source(struct userdata *u, const char *type, const char *prop,
@@ -136,7 +210,7 @@ void pa_classify_add_source(struct userdata *u, const char *type, const char *pr
     pa_assert(prop);
     pa_assert(arg);
 
-    devices_add(&classify->sources, type, prop, method, arg, ports, flags);
+    devices_add(&classify->sources, &classify->types, type, prop, method, arg, ports, flags);
 }
 
 void pa_classify_add_card(struct userdata *u, char *type,
@@ -151,7 +225,7 @@ void pa_classify_add_card(struct userdata *u, char *type,
     pa_assert(type);
     pa_assert(arg[0]);
 
-    cards_add(&classify->cards, type, method, arg, profiles, flags);
+    cards_add(&classify->cards, &classify->types, type, method, arg, profiles, flags);
 }
 
 
@@ -179,14 +253,20 @@ void pa_classify_add_stream(struct userdata *u, const char *prop,
             }
         }
 
-        streams_add(&classify->streams.defs, prop,method,arg,
+        streams_add(&classify->streams, prop,method,arg,
                     clnam, sname, uid, exe, grnam, flags);
+
+        if (prop)
+            cache_add_property(&classify->cache, prop);
+
+        cache_flush(&classify->cache, "stream definition");
     }
 }
 
 void pa_classify_update_stream_route(struct userdata *u, const char *sname)
 {
     struct pa_classify_stream_def *stream;
+    int changed = false;
 
     pa_assert(u);
     pa_assert(u->classify);
@@ -198,8 +278,12 @@ void pa_classify_update_stream_route(struct userdata *u, const char *sname)
             else
                 stream->sact = 0;
             pa_log_debug("stream group %s changes to %s state", stream->group, stream->sact ? "active" : "inactive");
+            changed = true;
         }
     }
+
+    if (changed)
+        cache_flush(&u->classify->cache, "stream route change");
 }
 
 void pa_classify_register_pid(struct userdata *u, pid_t pid, const char *prop,
@@ -212,8 +296,13 @@ void pa_classify_register_pid(struct userdata *u, pid_t pid, const char *prop,
     pa_assert_se((classify = u->classify));
 
     if (pid && group) {
-        pid_hash_insert(classify->streams.pid_hash, pid,
+        pid_hash_insert(&classify->streams.pid_hash, pid,
                         prop, method, arg, group);
+
+        if (prop)
+            cache_add_property(&classify->cache, prop);
+
+        cache_flush(&classify->cache, "pid registration");
     }
 }
 
@@ -226,7 +315,8 @@ void pa_classify_unregister_pid(struct userdata *u, pid_t pid, const char *prop,
     pa_assert_se((classify = u->classify));
 
     if (pid) {
-        pid_hash_remove(classify->streams.pid_hash, pid, prop, method, arg);
+        pid_hash_remove(&classify->streams.pid_hash, pid, prop, method, arg);
+        cache_flush(&classify->cache, "pid unregistration");
     }
 }
 
@@ -292,67 +382,215 @@ pa_classify_source_output_by_data(struct userdata *u,
     return group;
 }
 
-int pa_classify_sink(struct userdata *u, struct pa_sink *sink,
-                     uint32_t flag_mask, uint32_t flag_value,
-                     char *buf, int len)
+struct pa_classify_typeset *pa_classify_sink(struct userdata *u,
+                                             struct pa_sink *sink)
 {
     struct pa_classify *classify;
-    struct pa_classify_device_def *defs;
     const char *name;
 
     pa_assert(u);
     pa_assert_se((classify = u->classify));
     pa_assert(classify->sinks);
-    pa_assert_se((defs = classify->sinks->defs));
 
     name = pa_sink_ext_get_name(sink);
 
-    return devices_classify(defs, sink->proplist, name,
-                            flag_mask, flag_value, buf, len);
+    return devices_classify(classify->sinks, &classify->types,
+                            sink->proplist, name);
 }
 
-int pa_classify_source(struct userdata *u, struct pa_source *source,
-                       uint32_t flag_mask, uint32_t flag_value,
-                       char *buf, int len)
+struct pa_classify_typeset *pa_classify_source(struct userdata *u,
+                                               struct pa_source *source)
 {
     struct pa_classify *classify;
-    struct pa_classify_device_def *defs;
     const char *name;
 
     pa_assert(u);
     pa_assert_se((classify = u->classify));
     pa_assert(classify->sources);
-    pa_assert_se((defs = classify->sources->defs));
 
     name = pa_source_ext_get_name(source);
 
-    return devices_classify(defs, source->proplist, name,
-                            flag_mask, flag_value, buf, len);
+    return devices_classify(classify->sources, &classify->types,
+                            source->proplist, name);
 }
 
-int pa_classify_card(struct userdata *u, struct pa_card *card,
-                     uint32_t flag_mask, uint32_t flag_value,
-                     char *buf, int size)
+struct pa_classify_typeset *pa_classify_card(struct userdata *u,
+                                             struct pa_card *card)
 {
     struct pa_classify *classify;
-    struct pa_classify_card_def *defs;
+    struct pa_classify_typeset *ts;
     const char *name;
     char **profs;
-    int    len;
 
     pa_assert(u);
     pa_assert_se((classify = u->classify));
     pa_assert(classify->cards);
-    pa_assert_se((defs = classify->cards->defs));
 
     name  = pa_card_ext_get_name(card);
     profs = pa_card_ext_get_profiles(card);
 
-    len = cards_classify(defs, name,profs, flag_mask,flag_value, buf,size);
+    ts = cards_classify(classify->cards, &classify->types, name, profs);
 
     pa_xfree(profs);
 
-    return len;
+    return ts;
+}
+
+void pa_classify_typeset_free(struct pa_classify_typeset *ts)
+{
+    if (ts != NULL) {
+        pa_xfree(ts->typelist);
+        pa_xfree(ts);
+    }
+}
+
+int pa_classify_typeset_empty(struct pa_classify_typeset *ts)
+{
+    uint32_t i;
+
+    if (ts != NULL) {
+        for (i = 0;  i < ts->nword;  i++) {
+            if (ts->types[i])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+char *pa_classify_typeset_string(struct userdata *u,
+                                 struct pa_classify_typeset *ts)
+{
+    pa_assert(u);
+    pa_assert(ts);
+
+    return pa_xstrdup(ts->typelist ? ts->typelist : "");
+}
+
+int pa_classify_typeset_names(struct userdata *u,
+                              struct pa_classify_typeset *ts, int notify,
+                              const char **names, int max)
+{
+    struct pa_classify_types *types;
+    uint32_t *bits;
+    uint32_t  id;
+    int       n;
+
+    pa_assert(u);
+    pa_assert(u->classify);
+    pa_assert(ts);
+    pa_assert(names);
+
+    types = &u->classify->types;
+    bits  = notify ? ts->notify : ts->types;
+
+    for (id = 0, n = 0;  id < types->ntype;  id++) {
+        if (typeset_test(ts, bits, id)) {
+            if (n >= max) {
+                pa_log("%s() list overflow", __FUNCTION__);
+                return -1;
+            }
+            names[n++] = types->names[id];
+        }
+    }
+
+    return n;
+}
+
+void pa_classify_index_sink(struct userdata *u, struct pa_sink *sink,
+                            struct pa_classify_typeset *ts)
+{
+    struct pa_classify *classify;
+
+    pa_assert(u);
+    pa_assert_se((classify = u->classify));
+    pa_assert(sink);
+    pa_assert(ts);
+
+    types_index(&classify->types, pa_classify_member_sink, ts, sink);
+    types_index_ports(&classify->types, classify->sinks,
+                      pa_classify_member_port_sink,
+                      pa_sink_ext_get_name(sink), sink);
+}
+
+void pa_classify_unindex_sink(struct userdata *u, struct pa_sink *sink)
+{
+    struct pa_classify *classify;
+
+    pa_assert(u);
+    pa_assert_se((classify = u->classify));
+    pa_assert(sink);
+
+    types_unindex(&classify->types, pa_classify_member_sink, sink);
+    types_unindex(&classify->types, pa_classify_member_port_sink, sink);
+}
+
+void pa_classify_index_source(struct userdata *u, struct pa_source *source,
+                              struct pa_classify_typeset *ts)
+{
+    struct pa_classify *classify;
+
+    pa_assert(u);
+    pa_assert_se((classify = u->classify));
+    pa_assert(source);
+    pa_assert(ts);
+
+    types_index(&classify->types, pa_classify_member_source, ts, source);
+    types_index_ports(&classify->types, classify->sources,
+                      pa_classify_member_port_source,
+                      pa_source_ext_get_name(source), source);
+}
+
+void pa_classify_unindex_source(struct userdata *u, struct pa_source *source)
+{
+    struct pa_classify *classify;
+
+    pa_assert(u);
+    pa_assert_se((classify = u->classify));
+    pa_assert(source);
+
+    types_unindex(&classify->types, pa_classify_member_source, source);
+    types_unindex(&classify->types, pa_classify_member_port_source, source);
+}
+
+void pa_classify_index_card(struct userdata *u, struct pa_card *card,
+                            struct pa_classify_typeset *ts)
+{
+    struct pa_classify *classify;
+
+    pa_assert(u);
+    pa_assert_se((classify = u->classify));
+    pa_assert(card);
+    pa_assert(ts);
+
+    types_index(&classify->types, pa_classify_member_card, ts, card);
+}
+
+void pa_classify_unindex_card(struct userdata *u, struct pa_card *card)
+{
+    struct pa_classify *classify;
+
+    pa_assert(u);
+    pa_assert_se((classify = u->classify));
+    pa_assert(card);
+
+    types_unindex(&classify->types, pa_classify_member_card, card);
+}
+
+pa_idxset *pa_classify_type_members(struct userdata *u, const char *type,
+                                    enum pa_classify_member member)
+{
+    struct pa_classify *classify;
+    uint32_t id;
+
+    pa_assert(u);
+    pa_assert_se((classify = u->classify));
+    pa_assert(member < pa_classify_member_max);
+
+    if (!type || !types_lookup(&classify->types, type, &id))
+        return NULL;
+
+    return classify->types.members[id].objects[member];
 }
 
 int pa_classify_is_sink_typeof(struct userdata *u, struct pa_sink *sink,
@@ -361,6 +599,7 @@ int pa_classify_is_sink_typeof(struct userdata *u, struct pa_sink *sink,
 {
     struct pa_classify *classify;
     struct pa_classify_device_def *defs;
+    struct pa_sink_ext *ext;
     const char *name;
 
     pa_assert(u);
@@ -371,6 +610,11 @@ int pa_classify_is_sink_typeof(struct userdata *u, struct pa_sink *sink,
     if (!sink || !type)
         return false;
 
+    if ((ext = pa_sink_ext_lookup(u, sink)) && ext->typeset) {
+        return devices_typeset_is_typeof(defs, &classify->types,
+                                         ext->typeset, type, d);
+    }
+
     name = pa_sink_ext_get_name(sink);
 
     return devices_is_typeof(defs, sink->proplist, name, type, d);
@@ -383,6 +627,7 @@ int pa_classify_is_source_typeof(struct userdata *u, struct pa_source *source,
 {
     struct pa_classify *classify;
     struct pa_classify_device_def *defs;
+    struct pa_source_ext *ext;
     const char *name;
 
     pa_assert(u);
@@ -393,6 +638,11 @@ int pa_classify_is_source_typeof(struct userdata *u, struct pa_source *source,
     if (!source || !type)
         return false;
 
+    if ((ext = pa_source_ext_lookup(u, source)) && ext->typeset) {
+        return devices_typeset_is_typeof(defs, &classify->types,
+                                         ext->typeset, type, d);
+    }
+
     name = pa_source_ext_get_name(source);
 
     return devices_is_typeof(defs, source->proplist, name, type, d);
@@ -404,6 +654,7 @@ int pa_classify_is_card_typeof(struct userdata *u, struct pa_card *card,
 {
     struct pa_classify *classify;
     struct pa_classify_card_def *defs;
+    struct pa_card_ext *ext;
     const char *name;
 
     pa_assert(u);
@@ -414,6 +665,11 @@ int pa_classify_is_card_typeof(struct userdata *u, struct pa_card *card,
     if (!card || !type)
         return false;
 
+    if ((ext = pa_card_ext_lookup(u, card)) && ext->typeset) {
+        return card_typeset_is_typeof(defs, &classify->types, ext->typeset,
+                                      type, d, priority);
+    }
+
     name = pa_card_ext_get_name(card);
 
     return card_is_typeof(defs, name, type, d, priority);
@@ -471,20 +727,23 @@ static const char *find_group_for_client(struct userdata  *u,
                                          uint32_t         *flags_ret)
 {
     struct pa_classify *classify;
-    struct pa_classify_pid_hash **hash;
-    struct pa_classify_stream_def **defs;
+    struct pa_classify_pid_table *hash;
+    struct pa_classify_stream *streams;
+    struct pa_classify_cache_entry *entry;
     pid_t       pid   = 0;          /* client processs PID */
     const char *clnam = "";         /* client's name in PA */
     uid_t       uid   = (uid_t) -1; /* client process user ID */
     const char *exe   = "";         /* client's binary path */
     const char *group = NULL;
     uint32_t  flags = 0;
+    char        key[1024];
+    int         cacheable;
 
     assert(u);
     pa_assert_se((classify = u->classify));
 
-    hash = classify->streams.pid_hash;
-    defs = &classify->streams.defs;
+    hash = &classify->streams.pid_hash;
+    streams = &classify->streams;
 
     if (client == NULL) {
         /* sample cache initiated sink-inputs don't have a client, but sample's proplist
@@ -493,22 +752,30 @@ static const char *find_group_for_client(struct userdata  *u,
          * for sample cache initiated streams as well. */
         if (!(exe = pa_proplist_gets(proplist, PA_PROP_APPLICATION_PROCESS_BINARY)))
             exe = "";
-
-        group = streams_get_group(defs, proplist, clnam, uid, exe, &flags);
     } else {
-        pid = pa_client_ext_pid(client);
+        pid   = pa_client_ext_pid(client);
+        clnam = pa_client_ext_name(client);
+        uid   = pa_client_ext_uid(client);
+        exe   = pa_client_ext_exe(client);
+    }
 
-        if ((group = pid_hash_get_group(hash, pid, proplist)) == NULL) {
-            clnam = pa_client_ext_name(client);
-            uid   = pa_client_ext_uid(client);
-            exe   = pa_client_ext_exe(client);
+    cacheable = cache_key(&classify->cache, pid, uid, exe, clnam, proplist,
+                          key, sizeof(key)) == 0;
 
-            group = streams_get_group(defs, proplist, clnam, uid, exe, &flags);
-        }
+    if (cacheable && (entry = cache_lookup(&classify->cache, key))) {
+        group = entry->group;
+        flags = entry->flags;
     }
+    else {
+        if ((group = pid_hash_get_group(hash, pid, proplist)) == NULL)
+            group = streams_get_group(streams, proplist, clnam, uid, exe, &flags);
 
-    if (group == NULL)
-        group = PA_POLICY_DEFAULT_GROUP_NAME;
+        if (group == NULL)
+            group = PA_POLICY_DEFAULT_GROUP_NAME;
+
+        if (cacheable)
+            group = cache_add(&classify->cache, key, group, flags)->group;
+    }
 
     pa_log_debug("%s (%s|%d|%d|%s) => %s,0x%x", __FUNCTION__,
                  clnam?clnam:"<null>", pid, uid, exe?exe:"<null>",
@@ -520,6 +787,170 @@ static const char *find_group_for_client(struct userdata  *u,
     return group;
 }
 
+static void cache_init(struct pa_classify_cache *cache)
+{
+    pa_assert(cache);
+
+    cache->hash = pa_hashmap_new(pa_idxset_string_hash_func,
+                                 pa_idxset_string_compare_func);
+}
+
+static void cache_free(struct pa_classify_cache *cache)
+{
+    int i;
+
+    pa_assert(cache);
+
+    pa_log_info("classification cache: %u hits, %u misses",
+                cache->hits, cache->misses);
+
+    if (cache->hash) {
+        cache_flush(cache, NULL);
+        pa_hashmap_free(cache->hash);
+    }
+
+    for (i = 0;  i < cache->nprop;  i++)
+        pa_xfree(cache->props[i]);
+
+    pa_xfree(cache->props);
+}
+
+static void cache_flush(struct pa_classify_cache *cache, const char *reason)
+{
+    struct pa_classify_cache_entry *entry;
+    int i;
+
+    pa_assert(cache);
+
+    for (i = 0;  i < PA_POLICY_CLASSIFY_CACHE_MAX;  i++) {
+        if ((entry = cache->ring[i]) != NULL) {
+            pa_hashmap_remove(cache->hash, entry->key);
+            cache_entry_free(entry);
+            cache->ring[i] = NULL;
+        }
+    }
+
+    cache->next = 0;
+
+    if (reason) {
+        pa_log_debug("classification cache flushed on %s (%u hits, %u misses)",
+                     reason, cache->hits, cache->misses);
+    }
+}
+
+static void cache_add_property(struct pa_classify_cache *cache,
+                               const char *prop)
+{
+    int i;
+
+    pa_assert(cache);
+    pa_assert(prop);
+
+    for (i = 0;  i < cache->nprop;  i++) {
+        if (!strcmp(prop, cache->props[i]))
+            return;
+    }
+
+    cache->props = pa_xrealloc(cache->props,
+                               sizeof(char *) * (cache->nprop + 1));
+    cache->props[cache->nprop++] = pa_xstrdup(prop);
+}
+
+/*
+ * The key covers everything the pid hash and the stream definitions
+ * look at. Missing strings are kept distinct from empty ones as the
+ * rules treat them differently. Returns -1 if the key does not fit.
+ */
+static int cache_key(struct pa_classify_cache *cache, pid_t pid, uid_t uid,
+                     const char *exe, const char *clnam, pa_proplist *proplist,
+                     char *buf, size_t len)
+{
+#define APPEND(s)                                                       \
+    do {                                                                \
+        const char *v = (s);                                            \
+        l = v ? snprintf(p, (size_t)(e-p), "\x1f=%s", v) :              \
+                snprintf(p, (size_t)(e-p), "\x1f");                     \
+        if (l < 0 || (p += l) >= e)                                     \
+            return -1;                                                  \
+    } while (0)
+
+    char *p = buf;
+    char *e = buf + len;
+    int   l;
+    int   i;
+
+    pa_assert(cache);
+    pa_assert(buf);
+
+    l = snprintf(p, (size_t)(e-p), "%d\x1f%d", (int)pid, (int)uid);
+
+    if (l < 0 || (p += l) >= e)
+        return -1;
+
+    APPEND(exe);
+    APPEND(clnam);
+
+    for (i = 0;  i < cache->nprop;  i++)
+        APPEND(proplist ? pa_proplist_gets(proplist, cache->props[i]) : NULL);
+
+    return 0;
+
+#undef APPEND
+}
+
+static struct pa_classify_cache_entry *
+cache_lookup(struct pa_classify_cache *cache, const char *key)
+{
+    struct pa_classify_cache_entry *entry;
+
+    pa_assert(cache);
+    pa_assert(key);
+
+    if ((entry = pa_hashmap_get(cache->hash, key)) != NULL)
+        cache->hits++;
+    else
+        cache->misses++;
+
+    return entry;
+}
+
+static struct pa_classify_cache_entry *
+cache_add(struct pa_classify_cache *cache, const char *key, const char *group,
+          uint32_t flags)
+{
+    struct pa_classify_cache_entry *entry;
+
+    pa_assert(cache);
+    pa_assert(key);
+    pa_assert(group);
+
+    if ((entry = cache->ring[cache->next]) != NULL) {
+        pa_hashmap_remove(cache->hash, entry->key);
+        cache_entry_free(entry);
+    }
+
+    entry = pa_xnew0(struct pa_classify_cache_entry, 1);
+    entry->key   = pa_xstrdup(key);
+    entry->group = pa_xstrdup(group);
+    entry->flags = flags;
+
+    pa_hashmap_put(cache->hash, entry->key, entry);
+
+    cache->ring[cache->next] = entry;
+    cache->next = (cache->next + 1) % PA_POLICY_CLASSIFY_CACHE_MAX;
+
+    return entry;
+}
+
+static void cache_entry_free(struct pa_classify_cache_entry *entry)
+{
+    if (entry) {
+        pa_xfree(entry->key);
+        pa_xfree(entry->group);
+        pa_xfree(entry);
+    }
+}
+
 #if 0
 static char *arg_dump(int argc, char **argv, char *buf, size_t len)
 {
@@ -546,145 +977,129 @@ static char *arg_dump(int argc, char **argv, char *buf, size_t len)
 }
 #endif
 
-static void pid_hash_free(struct pa_classify_pid_hash **hash)
+static void pid_hash_free_rules(struct pa_classify_pid_hash *st)
 {
-    struct pa_classify_pid_hash *st;
-    int i;
-
-    assert(hash);
-
-    for (i = 0;   i < PA_POLICY_PID_HASH_MAX;   i++) {
-        while ((st = hash[i]) != NULL) {
-            hash[i] = st->next;
-
-            pa_xfree(st->prop);
-            pa_xfree(st->group);
-            pa_xfree(st->arg.def);
-
-            if (st->method.type == pa_method_matches)
-                regfree(&st->arg.value.rexp);
+    struct pa_classify_pid_rule *rule;
 
-            pa_xfree(st);
-        }
+    while ((rule = st->rules) != NULL) {
+        st->rules = rule->next;
+        pid_rule_free(rule);
     }
 }
 
-static void pid_hash_insert(struct pa_classify_pid_hash **hash, pid_t pid,
+static void pid_hash_insert(struct pa_classify_pid_table *table, pid_t pid,
                             const char *prop, enum pa_classify_method method,
                             const char *arg, const char *group)
 {
     struct pa_classify_pid_hash *st;
-    struct pa_classify_pid_hash *prev;
+    struct pa_classify_pid_rule *rule;
+    struct pa_classify_pid_rule **link;
 
-    pa_assert(hash);
+    pa_assert(table);
     pa_assert(group);
 
-    if ((st = pid_hash_find(hash, pid, prop,method,arg, &prev))) {
-        pa_xfree(st->group);
-        st->group = pa_xstrdup(group);
+    st = pa_pid_hash_get(table, pid);
+
+    if ((rule = pid_rule_find(st, prop,method,arg, &link))) {
+        pa_xfree(rule->group);
+        rule->group = pa_xstrdup(group);
 
         pa_log_debug("pid hash group changed (%u|%s|%s|%s|%s)", st->pid,
-                     st->prop ? st->prop : "", method_str(st->method.type),
-                     st->arg.def ? st->arg.def : "", st->group);
+                     rule->prop ? rule->prop : "", method_str(rule->method.type),
+                     rule->arg.def ? rule->arg.def : "", rule->group);
     }
     else {
-        st  = pa_xnew0(struct pa_classify_pid_hash, 1);
+        rule = pa_xnew0(struct pa_classify_pid_rule, 1);
 
-        st->next  = prev->next;
-        st->pid   = pid;
-        st->prop  = prop ? pa_xstrdup(prop) : NULL;
-        st->group = pa_xstrdup(group);
+        rule->prop  = prop ? pa_xstrdup(prop) : NULL;
+        rule->group = pa_xstrdup(group);
 
         if (!prop)
-            st->arg.def = pa_xstrdup("");
+            rule->arg.def = pa_xstrdup("");
         else {
-            st->method.type = method;
+            rule->method.type = method;
 
             switch (method) {
 
             case pa_method_equals:
-                st->method.func = pa_classify_method_equals;
-                st->arg.value.string = st->arg.def = pa_xstrdup(arg ? arg:"");
+                rule->method.func = pa_classify_method_equals;
+                rule->arg.value.string = rule->arg.def = pa_xstrdup(arg ? arg:"");
                 break;
 
             case pa_method_startswith:
-                st->method.func = pa_classify_method_startswith;
-                st->arg.value.string = st->arg.def = pa_xstrdup(arg ? arg:"");
+                rule->method.func = pa_classify_method_startswith;
+                rule->arg.value.string = rule->arg.def = pa_xstrdup(arg ? arg:"");
                 break;
 
             case pa_method_matches:
-                st->method.func = pa_classify_method_matches;
-                st->arg.def = pa_xstrdup(arg ? arg:"");
-                if (!arg || regcomp(&st->arg.value.rexp, arg, 0) != 0) {
-                    st->method.type = pa_method_true;
-                    st->method.func = pa_classify_method_true;
+                rule->method.func = pa_classify_method_matches;
+                rule->arg.def = pa_xstrdup(arg ? arg:"");
+                if (!arg || pa_classify_regex_compile(&rule->arg.value.regex, arg) != 0) {
+                    rule->method.type = pa_method_true;
+                    rule->method.func = pa_classify_method_true;
                 }
                 break;
 
             default:
             case pa_method_true:
-                st->method.func = pa_classify_method_true;
+                rule->method.func = pa_classify_method_true;
                 break;
             }
         }
 
-        prev->next = st;
+        /* rules are evaluated in the order of registration */
+        *link = rule;
 
         pa_log_debug("pid hash added (%u|%s|%s|%s|%s)", st->pid,
-                     st->prop ? st->prop : "", method_str(st->method.type),
-                     st->arg.def ? st->arg.def : "", st->group);
+                     rule->prop ? rule->prop : "", method_str(rule->method.type),
+                     rule->arg.def ? rule->arg.def : "", rule->group);
     }
 }
 
-static void pid_hash_remove(struct pa_classify_pid_hash **hash,
+static void pid_hash_remove(struct pa_classify_pid_table *table,
                             pid_t pid, const char *prop,
                             enum pa_classify_method method, const char *arg)
 {
     struct pa_classify_pid_hash *st;
-    struct pa_classify_pid_hash *prev;
+    struct pa_classify_pid_hash **stlink;
+    struct pa_classify_pid_rule *rule;
+    struct pa_classify_pid_rule **link;
 
-    pa_assert(hash);
+    pa_assert(table);
 
-    if ((st = pid_hash_find(hash, pid, prop,method,arg, &prev)) != NULL) {
-        prev->next = st->next;
-
-        pa_xfree(st->prop);
-        pa_xfree(st->group);
-        pa_xfree(st->arg.def);
+    if ((st = pa_pid_hash_find(table, pid, &stlink)) != NULL &&
+        (rule = pid_rule_find(st, prop,method,arg, &link)) != NULL)
+    {
+        *link = rule->next;
+        pid_rule_free(rule);
 
-        if (st->method.type == pa_method_matches)
-            regfree(&st->arg.value.rexp);
-        
-        pa_xfree(st);
+        if (st->rules == NULL)
+            pa_pid_hash_remove(table, stlink);
     }
 }
 
-static char *pid_hash_get_group(struct pa_classify_pid_hash **hash,
+static char *pid_hash_get_group(struct pa_classify_pid_table *table,
                                 pid_t pid, pa_proplist *proplist)
 {
     struct pa_classify_pid_hash *st;
-    int idx;
+    struct pa_classify_pid_rule *rule;
     char *propval;
     char *group = NULL;
 
-    pa_assert(hash);
+    pa_assert(table);
  
-    if (pid) {
-        idx = pid & PA_POLICY_PID_HASH_MASK;
-
-        for (st = hash[idx];  st != NULL;  st = st->next) {
-            if (pid == st->pid) {
-                if (!st->prop) {
-                    group = st->group;
-                    break;
-                }
+    if (pid && (st = pa_pid_hash_find(table, pid, NULL)) != NULL) {
+        for (rule = st->rules;  rule != NULL;  rule = rule->next) {
+            if (!rule->prop) {
+                group = rule->group;
+                break;
+            }
 
-                if ((propval = (char *)pa_proplist_gets(proplist, st->prop)) &&
-                    st->method.func(propval, &st->arg.value))
-                {
-                    group = st->group;
-                    break;
-                }
+            if ((propval = (char *)pa_proplist_gets(proplist, rule->prop)) &&
+                rule->method.func(propval, &rule->arg.value))
+            {
+                group = rule->group;
+                break;
             }
         }
     }
@@ -693,57 +1108,92 @@ static char *pid_hash_get_group(struct pa_classify_pid_hash **hash,
 }
 
 static struct
-pa_classify_pid_hash *pid_hash_find(struct pa_classify_pid_hash **hash,
-                                    pid_t pid, const char *prop,
+pa_classify_pid_rule *pid_rule_find(struct pa_classify_pid_hash *st,
+                                    const char *prop,
                                     enum pa_classify_method method,
                                     const char *arg,
-                                    struct pa_classify_pid_hash **prev_ret)
+                                    struct pa_classify_pid_rule ***link_ret)
 {
-    struct pa_classify_pid_hash *st;
-    struct pa_classify_pid_hash *prev;
-    int                          idx;
+    struct pa_classify_pid_rule *rule;
+    struct pa_classify_pid_rule **link;
 
-    idx = pid & PA_POLICY_PID_HASH_MASK;
+    for (link = &st->rules;  (rule = *link) != NULL;  link = &rule->next) {
+        if (!prop && !rule->prop)
+            break;
 
-    for (prev = (struct pa_classify_pid_hash *)&hash[idx];
-         (st = prev->next) != NULL;
-         prev = prev->next)
-    {
-        if (pid && pid == st->pid) {
-            if (!prop && !st->prop)
+        if (rule->prop && method == rule->method.type) {
+            if (method == pa_method_true)
                 break;
 
-            if (st->prop && method == st->method.type) {
-                if (method == pa_method_true)
-                    break;
-
-                if (arg && st->arg.def && !strcmp(arg, st->arg.def))
-                    break;
-            }
+            if (arg && rule->arg.def && !strcmp(arg, rule->arg.def))
+                break;
         }
     }
 
-    if (prev_ret)
-        *prev_ret = prev;
+    if (link_ret)
+        *link_ret = link;
 
-#if 0
-    pa_log_debug("%s(%d,'%s') => %p", __FUNCTION__,
-                 pid, stnam?stnam:"<null>", st);
-#endif
+    return rule;
+}
+
+static void pid_rule_free(struct pa_classify_pid_rule *rule)
+{
+    if (rule) {
+        pa_xfree(rule->prop);
+        pa_xfree(rule->group);
+        pa_xfree(rule->arg.def);
+
+        if (rule->method.type == pa_method_matches)
+            pa_classify_regex_free(&rule->arg.value.regex);
+
+        pa_xfree(rule);
+    }
+}
 
-    return st;
+static void streams_init(struct pa_classify_stream *streams)
+{
+    struct pa_classify_stream_index *idx;
+
+    pa_assert(streams);
+
+    idx = &streams->index;
+
+    idx->exe   = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                     pa_idxset_string_compare_func, NULL,
+                                     (pa_free_cb_t) stream_bucket_free);
+    idx->clnam = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                     pa_idxset_string_compare_func, NULL,
+                                     (pa_free_cb_t) stream_bucket_free);
+    idx->props = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                     pa_idxset_string_compare_func, NULL,
+                                     (pa_free_cb_t) stream_propidx_free);
+    idx->prefixes = prefixes_new();
 }
 
-static void streams_free(struct pa_classify_stream_def *defs)
+static void streams_free(struct pa_classify_stream *streams)
 {
+    struct pa_classify_stream_index *idx;
     struct pa_classify_stream_def *stream;
     struct pa_classify_stream_def *next;
 
-    for (stream = defs;  stream;  stream = next) {
+    pa_assert(streams);
+
+    idx = &streams->index;
+
+    if (idx->exe)
+        pa_hashmap_free(idx->exe);
+    if (idx->clnam)
+        pa_hashmap_free(idx->clnam);
+    if (idx->props)
+        pa_hashmap_free(idx->props);
+    if (idx->prefixes)
+        pa_hashmap_free(idx->prefixes);
+
+    for (stream = streams->defs;  stream;  stream = next) {
         next = stream->next;
 
         if (stream->method == pa_classify_method_matches)
-            regfree(&stream->arg.rexp);
+            pa_classify_regex_free(&stream->arg.regex);
         else
             pa_xfree((void *)stream->arg.string);
 
@@ -757,16 +1207,15 @@ static void streams_free(struct pa_classify_stream_def *defs)
     }
 }
 
-static void streams_add(struct pa_classify_stream_def **defs, const char *prop,
+static void streams_add(struct pa_classify_stream *streams, const char *prop,
                         enum pa_classify_method method, const char *arg, const char *clnam,
                         const char *sname, uid_t uid, const char *exe, const char *group, uint32_t flags)
 {
     struct pa_classify_stream_def *d;
-    struct pa_classify_stream_def *prev;
     pa_proplist *proplist = NULL;
     char         method_def[256];
 
-    pa_assert(defs);
+    pa_assert(streams);
     pa_assert(group);
 
     proplist = pa_proplist_new();
@@ -775,7 +1224,7 @@ static void streams_add(struct pa_classify_stream_def **defs, const char *prop,
         pa_proplist_sets(proplist, prop, arg);
     }
 
-    if ((d = streams_find(defs, proplist, clnam, sname, uid, exe, &prev)) != NULL) {
+    if ((d = streams_find(streams, proplist, clnam, sname, uid, exe)) != NULL) {
         pa_log_info("redefinition of stream");
         pa_xfree(d->group);
     }
@@ -807,7 +1256,7 @@ static void streams_add(struct pa_classify_stream_def **defs, const char *prop,
                 snprintf(method_def, sizeof(method_def),
                          "%s matches:%s",prop, arg);
                 d->method = pa_classify_method_matches;
-                if (regcomp(&d->arg.rexp, arg, 0) != 0) {
+                if (pa_classify_regex_compile(&d->arg.regex, arg) != 0) {
                     pa_log("%s: invalid regexp definition '%s'",
                            __FUNCTION__, arg);
                     pa_assert_se(0);
@@ -828,13 +1277,21 @@ static void streams_add(struct pa_classify_stream_def **defs, const char *prop,
             }
         }
 
+        d->seq   = streams->nseq++;
         d->uid   = uid;
         d->exe   = exe   ? pa_xstrdup(exe)   : NULL;
         d->clnam = clnam ? pa_xstrdup(clnam) : NULL;
         d->sname = sname ? pa_xstrdup(sname) : NULL;
         d->sact  = sname ? 0 : -1;
-        
-        prev->next = d;
+
+        if (streams->last)
+            streams->last->next = d;
+        else
+            streams->defs = d;
+
+        streams->last = d;
+
+        streams_index_add(&streams->index, d, d->prop ? method : pa_method_unknown);
 
         pa_log_debug("stream added (%d|%s|%s|%s|%d)", uid, exe?exe:"<null>",
                      clnam?clnam:"<null>", method_def, d->sact);
@@ -846,7 +1303,7 @@ static void streams_add(struct pa_classify_stream_def **defs, const char *prop,
     pa_proplist_free(proplist);
 }
 
-static const char *streams_get_group(struct pa_classify_stream_def **defs,
+static const char *streams_get_group(struct pa_classify_stream *streams,
                                      pa_proplist *proplist,
                                      const char *clnam, uid_t uid, const char *exe,
                                      uint32_t *flags_ret)
@@ -855,9 +1312,9 @@ static const char *streams_get_group(struct pa_classify_stream_def **defs,
     const char *group;
     uint32_t flags;
 
-    pa_assert(defs);
+    pa_assert(streams);
 
-    if ((d = streams_find(defs, proplist, clnam, NULL, uid, exe, NULL)) == NULL) {
+    if ((d = streams_find(streams, proplist, clnam, NULL, uid, exe)) == NULL) {
         group = NULL;
         flags = 0;
     }
@@ -872,56 +1329,61 @@ static const char *streams_get_group(struct pa_classify_stream_def **defs,
     return group;
 }
 
+/*
+ * Every stream definition sits in exactly one index bucket, chosen by the
+ * most selective exact key it has (exe, client name or an equals property).
+ * startswith definitions go to a prefix trie of their property and the
+ * rest of the definitions to the 'rest' bucket.  Buckets keep definitions
+ * in the order of definition, so the first match of each candidate bucket
+ * can be compared by sequence number and the earliest one wins, exactly
+ * as it did with a single linear walk.
+ */
 static struct pa_classify_stream_def *
-streams_find(struct pa_classify_stream_def **defs, pa_proplist *proplist,
-             const char *clnam, const char *sname, uid_t uid, const char *exe,
-             struct pa_classify_stream_def **prev_ret)
+streams_find(struct pa_classify_stream *streams, pa_proplist *proplist,
+             const char *clnam, const char *sname, uid_t uid, const char *exe)
 {
-#define PROPERTY_MATCH     (!d->prop || !d->method || \
-                           (d->method && d->method(prv, &d->arg)))
-#define STRING_MATCH_OF(m) (!d->m || (m && d->m && !strcmp(m, d->m)))
-#define ID_MATCH_OF(m)     (d->m == -1 || m == d->m)
+    struct pa_classify_stream_index   *idx;
+    struct pa_classify_stream_propidx *pi;
+    struct pa_classify_stream_bucket  *b;
+    struct pa_classify_stream_def     *d;
+    struct pa_classify_stream_def     *s;
+    struct pa_classify_prefix         *pf;
+    struct pa_classify_trie           *t;
+    const char *prv;
+    void *state;
+    int   i;
+
+    pa_assert(streams);
+
+    idx = &streams->index;
+    d   = NULL;
+
+    if (exe && (b = pa_hashmap_get(idx->exe, exe)))
+        d = stream_bucket_find(b, d, proplist, clnam, sname, uid, exe);
+
+    if (clnam && (b = pa_hashmap_get(idx->clnam, clnam)))
+        d = stream_bucket_find(b, d, proplist, clnam, sname, uid, exe);
+
+    PA_HASHMAP_FOREACH(pi, idx->props, state) {
+        if ((b = pa_hashmap_get(pi->values, stream_property(pi->prop, proplist))))
+            d = stream_bucket_find(b, d, proplist, clnam, sname, uid, exe);
+    }
 
-    struct pa_classify_stream_def *prev;
-    struct pa_classify_stream_def *d;
-    char *prv;
+    PA_HASHMAP_FOREACH(pf, idx->prefixes, state) {
+        prv = stream_property(pf->prop, proplist);
 
-    for (prev = (struct pa_classify_stream_def *)defs;
-         (d = prev->next) != NULL;
-         prev = prev->next)
-    {
-        if (!proplist || !d->prop ||
-            !(prv = (char *)pa_proplist_gets(proplist, d->prop)) || !prv[0])
-        {
-            prv = (char *)"<unknown>";
-        }
+        for (t = pf->trie;  t;  t = *prv ? trie_child(t, *prv++) : NULL) {
+            for (i = 0;  i < t->nentry;  i++) {
+                s = t->entries[i];
 
-#if 0
-        if (d->method == pa_classify_method_matches) {
-            pa_log_debug("%s: prv='%s' prop='%s' arg=<regexp>",
-                         __FUNCTION__, prv, d->prop?d->prop:"<null>");
-        }
-        else {
-            pa_log_debug("%s: prv='%s' prop='%s' arg='%s'",
-                         __FUNCTION__, prv, d->prop?d->prop:"<null>",
-                         d->arg.string?d->arg.string:"<null>");
+                if ((!d || s->seq < d->seq) &&
+                    stream_def_matches(s, proplist, clnam, sname, uid, exe))
+                    d = s;
+            }
         }
-#endif
-
-        if (PROPERTY_MATCH         &&
-            STRING_MATCH_OF(clnam) &&
-            ID_MATCH_OF(uid)       &&
-            /* case for dynamically changing active sink. */
-            (!sname || (sname && d->sname && !strcmp(sname, d->sname))) &&
-            (d->sact == -1 || d->sact == 1) &&
-            /* end special case */
-            STRING_MATCH_OF(exe)      )
-            break;
-
     }
 
-    if (prev_ret)
-        *prev_ret = prev;
+    d = stream_bucket_find(&idx->rest, d, proplist, clnam, sname, uid, exe);
 
 #if 0
     {
@@ -933,11 +1395,139 @@ streams_find(struct pa_classify_stream_def **defs, pa_proplist *proplist,
 #endif
 
     return d;
+}
+
+static void streams_index_add(struct pa_classify_stream_index *idx,
+                              struct pa_classify_stream_def *d,
+                              enum pa_classify_method method)
+{
+    struct pa_classify_stream_propidx *pi;
+    struct pa_classify_stream_bucket  *b;
+
+    pa_assert(idx);
+    pa_assert(d);
+
+    if (d->exe)
+        b = stream_bucket_get(idx->exe, d->exe, true);
+    else if (d->clnam)
+        b = stream_bucket_get(idx->clnam, d->clnam, true);
+    else if (method == pa_method_equals) {
+        if (!(pi = pa_hashmap_get(idx->props, d->prop))) {
+            pi = pa_xnew0(struct pa_classify_stream_propidx, 1);
+            pi->prop   = pa_xstrdup(d->prop);
+            pi->values = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                             pa_idxset_string_compare_func,
+                                             NULL,
+                                             (pa_free_cb_t) stream_bucket_free);
+            pa_hashmap_put(idx->props, pi->prop, pi);
+        }
+        b = stream_bucket_get(pi->values, d->arg.string, true);
+    }
+    else if (method == pa_method_startswith) {
+        trie_insert(prefixes_get(idx->prefixes, d->prop)->trie,
+                    d->arg.string, d);
+        return;
+    }
+    else
+        b = &idx->rest;
+
+    if (b->last)
+        b->last->inext = d;
+    else
+        b->first = d;
+
+    b->last = d;
+}
+
+static struct pa_classify_stream_bucket *stream_bucket_get(pa_hashmap *map,
+                                                           const char *key,
+                                                           int create)
+{
+    struct pa_classify_stream_bucket *b;
 
+    pa_assert(map);
+    pa_assert(key);
+
+    if (!(b = pa_hashmap_get(map, key)) && create) {
+        b = pa_xnew0(struct pa_classify_stream_bucket, 1);
+        b->key = pa_xstrdup(key);
+        pa_hashmap_put(map, b->key, b);
+    }
+
+    return b;
+}
+
+static void stream_bucket_free(struct pa_classify_stream_bucket *b)
+{
+    if (b) {
+        pa_xfree(b->key);
+        pa_xfree(b);
+    }
+}
+
+static void stream_propidx_free(struct pa_classify_stream_propidx *pi)
+{
+    if (pi) {
+        pa_hashmap_free(pi->values);
+        pa_xfree(pi->prop);
+        pa_xfree(pi);
+    }
+}
+
+static struct pa_classify_stream_def *
+stream_bucket_find(struct pa_classify_stream_bucket *b,
+                   struct pa_classify_stream_def *best, pa_proplist *proplist,
+                   const char *clnam, const char *sname, uid_t uid,
+                   const char *exe)
+{
+    struct pa_classify_stream_def *d;
+
+    for (d = b->first;  d && (!best || d->seq < best->seq);  d = d->inext) {
+        if (stream_def_matches(d, proplist, clnam, sname, uid, exe))
+            return d;
+    }
+
+    return best;
+}
+
+static int stream_def_matches(struct pa_classify_stream_def *d,
+                              pa_proplist *proplist, const char *clnam,
+                              const char *sname, uid_t uid, const char *exe)
+{
+#define PROPERTY_MATCH     (!d->prop || !d->method || \
+                           (d->method && d->method(prv, &d->arg)))
+#define STRING_MATCH_OF(m) (!d->m || (m && d->m && !strcmp(m, d->m)))
+#define ID_MATCH_OF(m)     (d->m == -1 || m == d->m)
+
+    const char *prv = stream_property(d->prop, proplist);
+
+    return PROPERTY_MATCH         &&
+           STRING_MATCH_OF(clnam) &&
+           ID_MATCH_OF(uid)       &&
+           /* case for dynamically changing active sink. */
+           (!sname || (sname && d->sname && !strcmp(sname, d->sname))) &&
+           (d->sact == -1 || d->sact == 1) &&
+           /* end special case */
+           STRING_MATCH_OF(exe);
+
+#undef PROPERTY_MATCH
 #undef STRING_MATCH_OF
 #undef ID_MATCH_OF
 }
 
+static const char *stream_property(const char *prop, pa_proplist *proplist)
+{
+    const char *prv;
+
+    if (!proplist || !prop ||
+        !(prv = pa_proplist_gets(proplist, prop)) || !prv[0])
+    {
+        prv = "<unknown>";
+    }
+
+    return prv;
+}
+
 void pa_classify_port_entry_free(struct pa_classify_port_entry *port) {
     pa_assert(port);
 
@@ -951,6 +1541,9 @@ static void devices_free(struct pa_classify_device *devices)
     struct pa_classify_device_def *d;
 
     if (devices) {
+        if (devices->prefixes)
+            pa_hashmap_free(devices->prefixes);
+
         for (d = devices->defs;  d->type;  d++) {
             pa_xfree((void *)d->type);
 
@@ -958,7 +1551,7 @@ static void devices_free(struct pa_classify_device *devices)
                 pa_hashmap_free(d->data.ports);
 
             if (d->method == pa_classify_method_matches)
-                regfree(&d->arg.rexp);
+                pa_classify_regex_free(&d->arg.regex);
             else
                 pa_xfree((void *)d->arg.string);
         }
@@ -967,7 +1560,8 @@ static void devices_free(struct pa_classify_device *devices)
     }
 }
 
-static void devices_add(struct pa_classify_device **p_devices, const char *type,
+static void devices_add(struct pa_classify_device **p_devices,
+                        struct pa_classify_types *types, const char *type,
                         const char *prop, enum pa_classify_method method, const char *arg,
                         pa_hashmap *ports, uint32_t flags)
 {
@@ -1041,7 +1635,7 @@ static void devices_add(struct pa_classify_device **p_devices, const char *type,
 
     case pa_method_matches:
         method_name = "matches";
-        if (regcomp(&d->arg.rexp, arg, 0) == 0) {
+        if (pa_classify_regex_compile(&d->arg.regex, arg) == 0) {
             d->method = pa_classify_method_matches;
             break;
         }
@@ -1054,6 +1648,16 @@ static void devices_add(struct pa_classify_device **p_devices, const char *type,
         return;
     }
 
+    d->typeid = types_intern(types, type);
+
+    if (method == pa_method_startswith) {
+        if (!devs->prefixes)
+            devs->prefixes = prefixes_new();
+
+        trie_insert(prefixes_get(devs->prefixes, d->prop)->trie, arg,
+                    PA_UINT32_TO_PTR(devs->ndef));
+    }
+
     devs->ndef++;
 
     ports_string = pa_strbuf_tostring_free(buf);
@@ -1064,43 +1668,72 @@ static void devices_add(struct pa_classify_device **p_devices, const char *type,
     pa_xfree(ports_string);
 }
 
-static int devices_classify(struct pa_classify_device_def *defs,
-                            pa_proplist *proplist, const char *name,
-                            uint32_t flag_mask, uint32_t flag_value,
-                            char *buf, int len)
+static struct pa_classify_typeset *
+devices_classify(struct pa_classify_device *devs,
+                 struct pa_classify_types *types,
+                 pa_proplist *proplist, const char *name)
 {
     struct pa_classify_device_def *d;
+    struct pa_classify_prefix *pf;
+    struct pa_classify_trie *t;
+    struct pa_classify_typeset *ts;
+    pa_strbuf  *buf;
     const char *propval;
-    char       *p;
-    char       *e;
     const char *s;
+    uint32_t    gen;
+    void       *state;
+    int         matches;
+    int         i;
 
-    pa_assert(buf);
-    pa_assert(len > 0);
+    pa_assert(devs);
+    pa_assert(types);
 
-    e = (p = buf) + len;
-    p[0] = '\0';
-    s = "";
+    ts  = typeset_new(types->ntype, devs->ndef);
+    buf = pa_strbuf_new();
+    s   = "";
 
-    for (d = defs;  d->type;  d++) {
-        propval = get_property(d->prop, proplist, name);
-
-        if (d->method(propval, &d->arg)) {
-            if ((d->data.flags & flag_mask) == flag_value) {
-                p += snprintf(p, (size_t)(e-p), "%s%s", s, d->type);
-                s  = " ";
-
-                if (p > e) {
-                    pa_log("%s() buffer overflow", __FUNCTION__);
-                    *buf = '\0';
-                    p = e;
-                    break;
-                }
+    /* mark the startswith definitions of all matching prefixes */
+    if ((gen = ++devs->generation) == 0) {
+        for (d = devs->defs;  d->type;  d++)
+            d->hit = 0;
+        gen = devs->generation = 1;
+    }
+
+    if (devs->prefixes) {
+        PA_HASHMAP_FOREACH(pf, devs->prefixes, state) {
+            propval = get_property(pf->prop, proplist, name);
+
+            for (t = pf->trie;  t;  t = *propval ? trie_child(t, *propval++) : NULL) {
+                for (i = 0;  i < t->nentry;  i++)
+                    devs->defs[PA_PTR_TO_UINT32(t->entries[i])].hit = gen;
             }
         }
     }
 
-    return (e - p);
+    for (d = devs->defs, i = 0;  d->type;  d++, i++) {
+        if (d->method == pa_classify_method_startswith)
+            matches = (d->hit == gen);
+        else {
+            propval = get_property(d->prop, proplist, name);
+            matches = d->method(propval, &d->arg);
+        }
+
+        if (matches) {
+            typeset_set(ts->defs, i);
+            typeset_set(ts->rules, d->typeid);
+            typeset_set(ts->types, d->typeid);
+
+            if (!(d->data.flags & PA_POLICY_DISABLE_NOTIFY))
+                typeset_set(ts->notify, d->typeid);
+
+            pa_strbuf_printf(buf, "%s%s", s, d->type);
+            s = " ";
+        }
+    }
+
+    ts->typelist = pa_strbuf_tostring_free(buf);
+
+    return ts;
 }
 
 static int devices_is_typeof(struct pa_classify_device_def *defs,
@@ -1127,12 +1760,39 @@ static int devices_is_typeof(struct pa_classify_device_def *defs,
     return false;
 }
 
+static int devices_typeset_is_typeof(struct pa_classify_device_def *defs,
+                                     struct pa_classify_types *types,
+                                     struct pa_classify_typeset *ts,
+                                     const char *type,
+                                     struct pa_classify_device_data **data)
+{
+    struct pa_classify_device_def *d;
+    uint32_t id;
+    uint32_t i;
+
+    if (!types_lookup(types, type, &id) || !typeset_test(ts, ts->rules, id))
+        return false;
+
+    if (data != NULL) {
+        for (d = defs, i = 0;  d->type;  d++, i++) {
+            if (d->typeid == id && typeset_test(ts, ts->defs, i)) {
+                *data = &d->data;
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
 static void cards_free(struct pa_classify_card *cards)
 {
     struct pa_classify_card_def *d;
     int i;
 
     if (cards) {
+        trie_free(cards->prefixes);
+
         for (d = cards->defs;  d->type;  d++) {
 
             pa_xfree((void *)d->type);
@@ -1141,7 +1801,7 @@ static void cards_free(struct pa_classify_card *cards)
                 pa_xfree((void *)d->data[i].profile);
 
                 if (d->data[i].method == pa_classify_method_matches)
-                    regfree(&d->data[i].arg.rexp);
+                    pa_classify_regex_free(&d->data[i].arg.regex);
                 else
                     pa_xfree((void *)d->data[i].arg.string);
             }
@@ -1151,7 +1811,8 @@ static void cards_free(struct pa_classify_card *cards)
     }
 }
 
-static void cards_add(struct pa_classify_card **p_cards, char *type,
+static void cards_add(struct pa_classify_card **p_cards,
+                      struct pa_classify_types *types, char *type,
                       enum pa_classify_method method[2], char **arg,
                       char **profiles, uint32_t flags[2])
 {
@@ -1198,7 +1859,7 @@ static void cards_add(struct pa_classify_card **p_cards, char *type,
 
         case pa_method_matches:
             method_name[i] = "matches";
-            if (regcomp(&data->arg.rexp, arg[i], 0) == 0) {
+            if (pa_classify_regex_compile(&data->arg.regex, arg[i]) == 0) {
                 data->method = pa_classify_method_matches;
                 break;
             }
@@ -1211,6 +1872,18 @@ static void cards_add(struct pa_classify_card **p_cards, char *type,
         }
     }
 
+    d->typeid = types_intern(types, type);
+
+    for (i = 0; i < 2 && profiles[i]; i++) {
+        if (method[i] == pa_method_startswith) {
+            if (!cards->prefixes)
+                cards->prefixes = trie_new('\0');
+
+            trie_insert(cards->prefixes, arg[i],
+                        PA_UINT32_TO_PTR(cards->ndef * 2 + i));
+        }
+    }
+
     cards->ndef++;
 
     pa_log_info("card '%s' added (%s|%s|%s|0x%04x)", type, method_name[0], arg[0],
@@ -1220,27 +1893,45 @@ static void cards_add(struct pa_classify_card **p_cards, char *type,
                     d->data[1].profile ? d->data[1].profile : "", d->data[1].flags);
 }
 
-static int cards_classify(struct pa_classify_card_def *defs,
-                          const char *name, char **profiles,
-                          uint32_t flag_mask, uint32_t flag_value,
-                          char *buf, int len)
+static struct pa_classify_typeset *
+cards_classify(struct pa_classify_card *cards, struct pa_classify_types *types,
+               const char *name, char **profiles)
 {
     struct pa_classify_card_def *d;
     struct pa_classify_card_data *data;
-    int         i,j;
-    char       *p;
-    char       *e;
+    struct pa_classify_trie *t;
+    struct pa_classify_typeset *ts;
+    pa_strbuf  *buf;
+    const char *n;
     const char *s;
+    int         i,j;
     int         supports_profile;
+    int         matches;
+    uint32_t    gen;
+    uint32_t    idx;
 
-    pa_assert(buf);
-    pa_assert(len > 0);
+    pa_assert(cards);
+    pa_assert(types);
+
+    ts  = typeset_new(types->ntype, cards->ndef * 2);
+    buf = pa_strbuf_new();
+    s   = "";
 
-    e = (p = buf) + len;
-    p[0] = '\0';
-    s = "";
+    /* mark the startswith entries of all matching prefixes */
+    if ((gen = ++cards->generation) == 0) {
+        for (d = cards->defs;  d->type;  d++)
+            d->data[0].hit = d->data[1].hit = 0;
+        gen = cards->generation = 1;
+    }
+
+    for (t = cards->prefixes, n = name;  t && n;  t = *n ? trie_child(t, *n++) : NULL) {
+        for (i = 0;  i < t->nentry;  i++) {
+            idx = PA_PTR_TO_UINT32(t->entries[i]);
+            cards->defs[idx / 2].data[idx % 2].hit = gen;
+        }
+    }
         
-    for (d = defs;  d->type;  d++) {
+    for (d = cards->defs, idx = 0;  d->type;  d++, idx += 2) {
 
         /* Check for both data[0] and data[1] */
 
@@ -1248,7 +1939,15 @@ static int cards_classify(struct pa_classify_card_def *defs,
 
             data = &d->data[i];
 
-            if (data->method(name, &data->arg)) {
+            if (data->method == pa_classify_method_startswith)
+                matches = (data->hit == gen);
+            else
+                matches = data->method(name, &data->arg);
+
+            if (matches) {
+                typeset_set(ts->defs, idx + i);
+                typeset_set(ts->rules, d->typeid);
+
                 if (data->profile == NULL)
                     supports_profile = true;
                 else {
@@ -1260,26 +1959,23 @@ static int cards_classify(struct pa_classify_card_def *defs,
                     }
                 }
 
-                if (supports_profile && (data->flags & flag_mask) == flag_value){
-                    p += snprintf(p, (size_t)(e-p), "%s%s", s, d->type);
-                    s  = " ";
+                if (supports_profile) {
+                    typeset_set(ts->types, d->typeid);
 
-                    if (p > e) {
-                        pa_log("%s(): buffer overflow", __FUNCTION__);
-                        *buf = '\0';
-                        p = e;
+                    if (!(data->flags & PA_POLICY_DISABLE_NOTIFY))
+                        typeset_set(ts->notify, d->typeid);
 
-                        /* leave from both for-loops */
-                        goto end;
-                    }
+                    pa_strbuf_printf(buf, "%s%s", s, d->type);
+                    s = " ";
                 }
             }
         }
 
     }
 
-end:
-    return (e - p);
+    ts->typelist = pa_strbuf_tostring_free(buf);
+
+    return ts;
 }
 
 static int card_is_typeof(struct pa_classify_card_def *defs, const char *name,
@@ -1307,6 +2003,39 @@ static int card_is_typeof(struct pa_classify_card_def *defs, const char *name,
     return false;
 }
 
+static int card_typeset_is_typeof(struct pa_classify_card_def *defs,
+                                  struct pa_classify_types *types,
+                                  struct pa_classify_typeset *ts,
+                                  const char *type,
+                                  struct pa_classify_card_data **data,
+                                  int *priority)
+{
+    struct pa_classify_card_def *d;
+    uint32_t id;
+    uint32_t idx;
+    int i;
+
+    if (!types_lookup(types, type, &id) || !typeset_test(ts, ts->rules, id))
+        return false;
+
+    for (d = defs, idx = 0;  d->type;  d++, idx += 2) {
+        if (d->typeid == id) {
+            for (i = 0; i < 2 && d->data[i].profile; i++) {
+                if (typeset_test(ts, ts->defs, idx + i)) {
+                    if (data != NULL)
+                        *data = &d->data[i];
+                    if (priority != NULL)
+                        *priority = i;
+
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
 static int port_device_is_typeof(struct pa_classify_device_def *defs,
                                  const char *name, const char *type,
                                  struct pa_classify_device_data **data)
@@ -1384,38 +2113,261 @@ int pa_classify_method_startswith(const char *string,
 int pa_classify_method_matches(const char *string,
                                union pa_classify_arg *arg)
 {
-#define MAX_MATCH 5
+    return arg ? pa_classify_regex_match(&arg->regex, string) : false;
+}
 
-    regmatch_t m[MAX_MATCH];
-    regoff_t   end;
-    int        found;
-    
-    found = false;
+int pa_classify_method_true(const char *string,
+                            union pa_classify_arg *arg)
+{
+    (void)string;
+    (void)arg;
 
-    if (string && arg) {
-        if (regexec(&arg->rexp, string, MAX_MATCH, m, 0) == 0) {
-            end = strlen(string);
+    return true;
+}
+
+static void types_init(struct pa_classify_types *types)
+{
+    types->ids   = pa_hashmap_new(pa_idxset_string_hash_func,
+                                  pa_idxset_string_compare_func);
+    types->names = NULL;
+    types->members = NULL;
+    types->ntype = 0;
+}
+
+static void types_free(struct pa_classify_types *types)
+{
+    uint32_t id;
+    int      m;
+
+    if (types->ids)
+        pa_hashmap_free(types->ids);
 
-            if (m[0].rm_so == 0 && m[0].rm_eo == end && m[1].rm_so == -1)
-                found = true;
-        }  
+    for (id = 0;  id < types->ntype;  id++) {
+        pa_xfree(types->names[id]);
+
+        for (m = 0;  m < pa_classify_member_max;  m++) {
+            if (types->members[id].objects[m])
+                pa_idxset_free(types->members[id].objects[m], NULL);
+        }
     }
 
+    pa_xfree(types->names);
+    pa_xfree(types->members);
+}
 
-    return found;
+static uint32_t types_intern(struct pa_classify_types *types, const char *type)
+{
+    uint32_t id;
+
+    if (types_lookup(types, type, &id))
+        return id;
+
+    id = types->ntype++;
 
-#undef MAX_MATCH
+    types->names = pa_xrealloc(types->names, sizeof(char *) * types->ntype);
+    types->names[id] = pa_xstrdup(type);
+
+    types->members = pa_xrealloc(types->members,
+                                 sizeof(types->members[0]) * types->ntype);
+    memset(types->members + id, 0, sizeof(types->members[0]));
+
+    pa_hashmap_put(types->ids, types->names[id], PA_UINT32_TO_PTR(id + 1));
+
+    return id;
 }
 
-int pa_classify_method_true(const char *string,
-                            union pa_classify_arg *arg)
+static int types_lookup(struct pa_classify_types *types, const char *type,
+                        uint32_t *id)
 {
-    (void)string;
-    (void)arg;
+    void *value;
+
+    if ((value = pa_hashmap_get(types->ids, type)) == NULL)
+        return false;
+
+    *id = PA_PTR_TO_UINT32(value) - 1;
 
     return true;
 }
 
+static void types_add_member(struct pa_classify_types *types, uint32_t id,
+                             enum pa_classify_member member, void *obj)
+{
+    pa_idxset **objects;
+
+    pa_assert(id < types->ntype);
+
+    objects = types->members[id].objects + member;
+
+    if (*objects == NULL) {
+        *objects = pa_idxset_new(pa_idxset_trivial_hash_func,
+                                 pa_idxset_trivial_compare_func);
+    }
+
+    pa_idxset_put(*objects, obj, NULL);
+}
+
+static void types_index(struct pa_classify_types *types,
+                        enum pa_classify_member member,
+                        struct pa_classify_typeset *ts, void *obj)
+{
+    uint32_t id;
+
+    for (id = 0;  id < types->ntype;  id++) {
+        if (typeset_test(ts, ts->rules, id))
+            types_add_member(types, id, member, obj);
+    }
+}
+
+static void types_unindex(struct pa_classify_types *types,
+                          enum pa_classify_member member, void *obj)
+{
+    pa_idxset *objects;
+    uint32_t   id;
+
+    for (id = 0;  id < types->ntype;  id++) {
+        if ((objects = types->members[id].objects[member]) != NULL)
+            pa_idxset_remove_by_data(objects, obj, NULL);
+    }
+}
+
+static void types_index_ports(struct pa_classify_types *types,
+                              struct pa_classify_device *devs,
+                              enum pa_classify_member member,
+                              const char *name, void *obj)
+{
+    struct pa_classify_device_def *d;
+
+    for (d = devs->defs;  d->type;  d++) {
+        if (d->data.ports && pa_hashmap_get(d->data.ports, name))
+            types_add_member(types, d->typeid, member, obj);
+    }
+}
+
+static struct pa_classify_typeset *typeset_new(uint32_t ntype, uint32_t ndef)
+{
+    struct pa_classify_typeset *ts;
+    uint32_t nword;
+
+    nword = ((ntype > ndef ? ntype : ndef) + 31) / 32;
+
+    ts = pa_xmalloc0(sizeof(*ts) + sizeof(uint32_t) * nword * 4);
+
+    ts->nword  = nword;
+    ts->types  = (uint32_t *)(ts + 1);
+    ts->notify = ts->types  + nword;
+    ts->rules  = ts->notify + nword;
+    ts->defs   = ts->rules  + nword;
+
+    return ts;
+}
+
+static void typeset_set(uint32_t *bits, uint32_t n)
+{
+    bits[n / 32] |= (1U << (n % 32));
+}
+
+static int typeset_test(struct pa_classify_typeset *ts, uint32_t *bits,
+                        uint32_t n)
+{
+    if (n / 32 >= ts->nword)
+        return false;
+
+    return (bits[n / 32] & (1U << (n % 32))) ? true : false;
+}
+
+static struct pa_classify_trie *trie_new(char c)
+{
+    struct pa_classify_trie *t;
+
+    t = pa_xnew0(struct pa_classify_trie, 1);
+    t->c = c;
+
+    return t;
+}
+
+static void trie_free(struct pa_classify_trie *t)
+{
+    struct pa_classify_trie *next;
+
+    for (;  t;  t = next) {
+        next = t->next;
+
+        trie_free(t->child);
+
+        pa_xfree(t->entries);
+        pa_xfree(t);
+    }
+}
+
+static void trie_insert(struct pa_classify_trie *root, const char *prefix,
+                        void *entry)
+{
+    struct pa_classify_trie *t;
+    struct pa_classify_trie *child;
+    const char *p;
+
+    pa_assert(root);
+    pa_assert(prefix);
+
+    for (t = root, p = prefix;  *p;  t = child, p++) {
+        if (!(child = trie_child(t, *p))) {
+            child = trie_new(*p);
+            child->next = t->child;
+            t->child = child;
+        }
+    }
+
+    t->entries = pa_xrealloc(t->entries, sizeof(void *) * (t->nentry + 1));
+    t->entries[t->nentry++] = entry;
+}
+
+static struct pa_classify_trie *trie_child(struct pa_classify_trie *t, char c)
+{
+    struct pa_classify_trie *child;
+
+    for (child = t->child;  child;  child = child->next) {
+        if (child->c == c)
+            break;
+    }
+
+    return child;
+}
+
+static pa_hashmap *prefixes_new(void)
+{
+    return pa_hashmap_new_full(pa_idxset_string_hash_func,
+                               pa_idxset_string_compare_func, NULL,
+                               (pa_free_cb_t) prefix_free);
+}
+
+static struct pa_classify_prefix *prefixes_get(pa_hashmap *prefixes,
+                                               const char *prop)
+{
+    struct pa_classify_prefix *pf;
+
+    pa_assert(prefixes);
+    pa_assert(prop);
+
+    if (!(pf = pa_hashmap_get(prefixes, prop))) {
+        pf = pa_xnew0(struct pa_classify_prefix, 1);
+        pf->prop = pa_xstrdup(prop);
+        pf->trie = trie_new('\0');
+
+        pa_hashmap_put(prefixes, pf->prop, pf);
+    }
+
+    return pf;
+}
+
+static void prefix_free(struct pa_classify_prefix *pf)
+{
+    if (pf) {
+        trie_free(pf->trie);
+        pa_xfree(pf->prop);
+        pa_xfree(pf);
+    }
+}
+
 static const char *method_str(enum pa_classify_method method)
 {
     switch (method) {
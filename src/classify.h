@@ -2,13 +2,12 @@
 #define fooclassifyfoo
 
 #include <sys/types.h>
-#include <regex.h>
 
 #include "userdata.h"
+#include "classify-regex.h"
+#include "pid-hash.h"
 
-#define PA_POLICY_PID_HASH_BITS  6
-#define PA_POLICY_PID_HASH_MAX   (1 << PA_POLICY_PID_HASH_BITS)
-#define PA_POLICY_PID_HASH_MASK  (PA_POLICY_PID_HASH_MAX - 1)
+#define PA_POLICY_CLASSIFY_CACHE_MAX  256
 
 /* card flags */
 #define PA_POLICY_DISABLE_NOTIFY (1UL << 0)
@@ -39,13 +38,25 @@ enum pa_classify_method {
 };
 
 union pa_classify_arg {
-    const char *string;
-    regex_t     rexp;
+    const char              *string;
+    struct pa_classify_regex regex;
 };
 
-struct pa_classify_pid_hash {
-    struct pa_classify_pid_hash *next;
-    pid_t                        pid;   /* process id (or parent process id) */
+struct pa_classify_trie {
+    char                          c;       /* character leading here */
+    struct pa_classify_trie      *child;   /* first child */
+    struct pa_classify_trie      *next;    /* next sibling */
+    int                           nentry;
+    void                        **entries; /* rules with the prefix ending here */
+};
+
+struct pa_classify_prefix {
+    char                         *prop;    /* property the prefixes apply to */
+    struct pa_classify_trie      *trie;
+};
+
+struct pa_classify_pid_rule {
+    struct pa_classify_pid_rule *next;
                                         /* for stream classification */
     char                        *prop;  /*     stream property, if any  */
     struct {
@@ -61,6 +72,8 @@ struct pa_classify_pid_hash {
 
 struct pa_classify_stream_def {
     struct pa_classify_stream_def *next;
+    struct pa_classify_stream_def *inext; /* next def in the same index bucket */
+    uint32_t                       seq;   /* order of definition */
                                           /* for stream classification */
     char                          *prop;  /*   stream property */
     int                          (*method)(const char *,
@@ -76,11 +89,49 @@ struct pa_classify_stream_def {
                                              PA_POLICY_LOCAL_MUTE   */
 };
 
+struct pa_classify_stream_bucket {
+    char                          *key;
+    struct pa_classify_stream_def *first; /* defs in the order of definition */
+    struct pa_classify_stream_def *last;
+};
+
+struct pa_classify_stream_propidx {
+    char                          *prop;   /* stream property */
+    pa_hashmap                    *values; /* equals: value => bucket */
+};
+
+struct pa_classify_stream_index {
+    pa_hashmap                      *exe;   /* exe name => bucket */
+    pa_hashmap                      *clnam; /* client name => bucket */
+    pa_hashmap                      *props; /* property => propidx */
+    pa_hashmap                      *prefixes; /* property => startswith trie */
+    struct pa_classify_stream_bucket rest;  /* matches/true/uid */
+};
+
 struct pa_classify_stream {
-    struct pa_classify_pid_hash   *pid_hash[PA_POLICY_PID_HASH_MAX];
-    struct pa_classify_stream_def *defs;
+    struct pa_classify_pid_table    pid_hash;
+    struct pa_classify_stream_def  *defs;
+    struct pa_classify_stream_def  *last;
+    uint32_t                        nseq;
+    struct pa_classify_stream_index index;
 };
 
+struct pa_classify_cache_entry {
+    char                          *key;   /* pid, uid, exe, client name and */
+                                          /* the values of rule properties */
+    char                          *group; /* policy group name */
+    uint32_t                       flags; /* stream flags */
+};
+
+struct pa_classify_cache {
+    pa_hashmap                     *hash;   /* key => entry */
+    struct pa_classify_cache_entry *ring[PA_POLICY_CLASSIFY_CACHE_MAX];
+    int                             next;   /* next ring slot to reuse */
+    char                          **props;  /* properties referred by rules */
+    int                             nprop;
+    uint32_t                        hits;
+    uint32_t                        misses;
+};
 
 struct pa_classify_port_entry {
     char *device_name; /* Sink or source name */
@@ -102,9 +153,14 @@ struct pa_classify_device_def {
                                              union pa_classify_arg *);
     union pa_classify_arg            arg;   /*   argument */
     struct pa_classify_device_data   data;  /* data associated with device */
+    uint32_t                         hit;   /* generation of last prefix hit */
+    uint32_t                         typeid;/* interned 'type' */
 };
 
 struct pa_classify_device {
+    pa_hashmap                      *prefixes;   /* property => trie of
+                                                    startswith def indices */
+    uint32_t                         generation;
     int                              ndef;
     struct pa_classify_device_def    defs[1];
 };
@@ -114,23 +170,63 @@ struct pa_classify_card_data {
     uint32_t                     flags;   /* PA_POLICY_DISABLE_NOTIFY, etc */
     int                        (*method)(const char *,union pa_classify_arg *);
     union pa_classify_arg        arg;
+    uint32_t                     hit;     /* generation of last prefix hit */
 };
 
 struct pa_classify_card_def {
     const char                  *type; /* handled device name, e.g ihf */
     struct pa_classify_card_data data[2]; /* data associated with device 'type' */
+    uint32_t                     typeid;  /* interned 'type' */
 };
 
 struct pa_classify_card {
+    struct pa_classify_trie     *prefixes;   /* startswith data entries */
+    uint32_t                     generation;
     int                          ndef;
     struct pa_classify_card_def  defs[1];
 };
 
+enum pa_classify_member {
+    pa_classify_member_sink = 0,
+    pa_classify_member_source,
+    pa_classify_member_card,
+    pa_classify_member_port_sink,     /* sinks in the ports= of the type */
+    pa_classify_member_port_source,   /* sources in the ports= of the type */
+    pa_classify_member_max
+};
+
+struct pa_classify_type_members {
+    pa_idxset                   *objects[pa_classify_member_max];
+};
+
+struct pa_classify_types {
+    pa_hashmap                  *ids;    /* type name => id + 1 */
+    char                       **names;  /* type names indexed by id */
+    struct pa_classify_type_members *members; /* live objects by type id */
+    uint32_t                     ntype;
+};
+
+/*
+ * device types of a sink, source or card evaluated once when the object
+ * appears; all members are bitmaps, the first two indexed by type id,
+ * the last one by definition index (def * 2 + i for cards)
+ */
+struct pa_classify_typeset {
+    uint32_t                     nword;  /* length of each bitmap */
+    uint32_t                    *types;  /* the content of the typelist */
+    uint32_t                    *notify; /* types not PA_POLICY_DISABLE_NOTIFY */
+    uint32_t                    *rules;  /* types with a matching rule */
+    uint32_t                    *defs;   /* matching definitions */
+    char                        *typelist; /* in the order of definition */
+};
+
 struct pa_classify {
+    struct pa_classify_types     types;
     struct pa_classify_stream    streams;
     struct pa_classify_device   *sinks;
     struct pa_classify_device   *sources;
     struct pa_classify_card     *cards;
+    struct pa_classify_cache     cache;
 };
 
 
@@ -165,12 +261,30 @@ const char *pa_classify_source_output(struct userdata *u, struct pa_source_outpu
 const char *pa_classify_source_output_by_data(struct userdata *u,
                                         struct pa_source_output_new_data *data);
 
-int   pa_classify_sink(struct userdata *, struct pa_sink *,
-                       uint32_t, uint32_t, char *, int);
-int   pa_classify_source(struct userdata *, struct pa_source *,
-                         uint32_t, uint32_t, char *, int);
-int   pa_classify_card(struct userdata *, struct pa_card *,
-                       uint32_t, uint32_t, char *, int);
+struct pa_classify_typeset *pa_classify_sink(struct userdata *,
+                                             struct pa_sink *);
+struct pa_classify_typeset *pa_classify_source(struct userdata *,
+                                               struct pa_source *);
+struct pa_classify_typeset *pa_classify_card(struct userdata *,
+                                             struct pa_card *);
+void  pa_classify_typeset_free(struct pa_classify_typeset *);
+int   pa_classify_typeset_empty(struct pa_classify_typeset *);
+char *pa_classify_typeset_string(struct userdata *,
+                                 struct pa_classify_typeset *);
+int   pa_classify_typeset_names(struct userdata *, struct pa_classify_typeset *,
+                                int, const char **, int);
+
+void  pa_classify_index_sink(struct userdata *, struct pa_sink *,
+                             struct pa_classify_typeset *);
+void  pa_classify_unindex_sink(struct userdata *, struct pa_sink *);
+void  pa_classify_index_source(struct userdata *, struct pa_source *,
+                               struct pa_classify_typeset *);
+void  pa_classify_unindex_source(struct userdata *, struct pa_source *);
+void  pa_classify_index_card(struct userdata *, struct pa_card *,
+                             struct pa_classify_typeset *);
+void  pa_classify_unindex_card(struct userdata *, struct pa_card *);
+pa_idxset *pa_classify_type_members(struct userdata *, const char *,
+                                    enum pa_classify_member);
 
 int   pa_classify_is_sink_typeof(struct userdata *, struct pa_sink *,
                                  const char *,
@@ -197,6 +311,7 @@ int   pa_classify_method_startswith(const char *, union pa_classify_arg *);
 int   pa_classify_method_matches(const char *, union pa_classify_arg *);
 int   pa_classify_method_true(const char *, union pa_classify_arg *);
 
+
 #endif
 
 
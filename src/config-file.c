@@ -947,6 +947,13 @@ static int groupdef_parse(int lineno, char *line, struct groupdef *grdef)
                             flags |= PA_POLICY_GROUP_FLAG_CORK_STREAM;
                         else if (!strcmp(flname, "mute_by_route"))
                             flags |= PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE;
+                        else if (!strcmp(flname, "mute_by_volume"))
+                            flags |= PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE |
+                                     PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME;
+                        else if (!strcmp(flname, "mute_cork"))
+                            flags |= PA_POLICY_GROUP_FLAG_MUTE_CORK;
+                        else if (!strcmp(flname, "lazy_apply"))
+                            flags |= PA_POLICY_GROUP_FLAG_LAZY_APPLY;
                         else if (!strcmp(flname, "media_notify"))
                             flags |= PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY;
                         else {
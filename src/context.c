@@ -12,13 +12,28 @@
 #include "sink-input-ext.h"
 #include "source-output-ext.h"
 
+struct object_visit {
+    enum pa_policy_object_type  type;
+    const char                 *name;
+    void                       *ptr;
+    unsigned long               index;
+};
+
 static struct pa_policy_context_variable
             *add_variable(struct pa_policy_context *, const char *);
 static void delete_variable(struct pa_policy_context *,
                             struct pa_policy_context_variable *);
+static void index_rule(struct pa_policy_context_variable *,
+                       struct pa_policy_context_rule *);
+static void rule_bucket_append(struct pa_policy_rule_bucket *,
+                               struct pa_policy_context_rule *);
+static void rule_bucket_free(struct pa_policy_rule_bucket *);
+static void log_rule_actions(struct pa_policy_context *,
+                             struct pa_policy_context_rule *, const char *);
 
 static struct pa_policy_context_rule
             *add_rule(struct pa_policy_context_rule **,
+                      struct pa_policy_object_index *,
                       enum pa_classify_method, const char *);
 static void  delete_rule(struct pa_policy_context_rule **,
                          struct pa_policy_context_rule  *);
@@ -29,6 +44,9 @@ static void  delete_action(union pa_policy_context_action **,
                            union pa_policy_context_action *);
 static int perform_action(struct userdata *, union pa_policy_context_action *,
                           char *);
+static void log_change(struct pa_policy_context *,
+                       union pa_policy_context_action *, const char *);
+static void clear_changes(struct pa_policy_context *);
 
 static int   match_setup(struct pa_policy_match *, enum pa_classify_method,
                          const char *, enum pa_classify_method *);
@@ -38,20 +56,24 @@ static int   value_setup(union pa_policy_value *, enum pa_policy_value_type,
                          va_list);
 static void  value_cleanup(union pa_policy_value *);
 
-static void register_object(struct pa_policy_object *,
-                            enum pa_policy_object_type,
-                            const char *, void *, int);
-static void unregister_object(struct pa_policy_object *,
-                              enum pa_policy_object_type, const char *,
-                              void *, unsigned long, int);
+static void index_add_object(struct pa_policy_object_index *,
+                             struct pa_policy_object *, int);
+static void register_objects(struct pa_policy_object_index *,
+                             enum pa_policy_object_type, const char *, void *);
+static void unregister_objects(struct pa_policy_object_index *,
+                               enum pa_policy_object_type, const char *,
+                               void *, unsigned long);
+static void register_object(struct pa_policy_object *, int, void *);
+static void unregister_object(struct pa_policy_object *, int, void *);
 static const char *get_object_property(struct pa_policy_object *,const char *);
-static void set_object_property(struct pa_policy_object *,
+static void set_object_property(struct userdata *, struct pa_policy_object *,
                                 const char *, const char *);
-static void delete_object_property(struct pa_policy_object *, const char *);
+static void delete_object_property(struct userdata *,
+                                   struct pa_policy_object *, const char *);
 static pa_proplist *get_object_proplist(struct pa_policy_object *);
 static int object_assert(struct userdata *, struct pa_policy_object *);
 static const char *object_name(struct pa_policy_object *);
-static void fire_object_property_changed_hook(struct pa_policy_object *object);
+static void fire_proplist_changed_hook(enum pa_policy_object_type, void *);
 
 static unsigned long object_index(enum pa_policy_object_type, void *);
 static const char *object_type_str(enum pa_policy_object_type);
@@ -62,6 +84,11 @@ static struct pa_policy_activity_variable
 static void delete_activity(struct pa_policy_context *,
                             struct pa_policy_activity_variable *);
 static void apply_activity(struct userdata *u, struct pa_policy_activity_variable *var);
+static struct pa_policy_activity_sink
+            *get_activity_sink(struct pa_policy_context *, const char *);
+static void activity_sink_free(struct pa_policy_activity_sink *);
+static void drop_activity_sink(struct pa_policy_context *, const char *);
+static void flush_activity_sinks(struct pa_policy_context *);
 
 struct pa_policy_context *pa_policy_context_new(struct userdata *u)
 {
@@ -69,6 +96,9 @@ struct pa_policy_context *pa_policy_context_new(struct userdata *u)
 
     ctx = pa_xmalloc0(sizeof(*ctx));
 
+    ctx->varidx = pa_hashmap_new(pa_idxset_string_hash_func,
+                                 pa_idxset_string_compare_func);
+
     return ctx;
 }
 
@@ -76,98 +106,38 @@ void pa_policy_context_free(struct pa_policy_context *ctx)
 {
     if (ctx != NULL) {
 
+        pa_policy_object_index_free(&ctx->varobjs);
+        pa_policy_object_index_free(&ctx->actobjs);
+
         while (ctx->variables != NULL)
             delete_variable(ctx, ctx->variables);
 
-        while (ctx->activities != NULL)
-            delete_activity(ctx, ctx->activities);
+        if (ctx->varidx != NULL)
+            pa_hashmap_free(ctx->varidx);
 
-        pa_xfree(ctx);
-    }
-}
+        if (ctx->sink_state_changed_hook_slot != NULL)
+            pa_hook_slot_free(ctx->sink_state_changed_hook_slot);
 
-static void register_rule(struct pa_policy_context_rule *rule,
-                          enum pa_policy_object_type type,
-                          const char *name, void *ptr) {
-    union  pa_policy_context_action    *actn;
-    struct pa_policy_set_property      *setprop;
-    struct pa_policy_del_property      *delprop;
-    struct pa_policy_object            *object;
-    int                                 lineno;
+        flush_activity_sinks(ctx);
 
-    for (actn = rule->actions;  actn != NULL;  actn = actn->any.next) {
-
-        switch (actn->any.type) {
-
-        case pa_policy_set_property:
-            setprop = &actn->setprop;
-            lineno  = setprop->lineno;
-            object  = &setprop->object;
-            break;
-
-        case pa_policy_delete_property:
-            delprop = &actn->delprop;
-            lineno  = delprop->lineno;
-            object  = &delprop->object;
-            break;
+        while (ctx->activities != NULL)
+            delete_activity(ctx, ctx->activities);
 
-        default:
-            continue;
-        } /* switch */
+        clear_changes(ctx);
+        pa_xfree(ctx->changes);
 
-        register_object(object, type, name, ptr, lineno);
+        if (ctx->dirty != NULL)
+            pa_hashmap_free(ctx->dirty);
 
-    }  /* for actn */
+        pa_xfree(ctx);
+    }
 }
 
 void pa_policy_context_register(struct userdata *u,
                                 enum pa_policy_object_type what,
                                 const char *name, void *ptr)
 {
-    struct pa_policy_context_variable *var;
-    struct pa_policy_context_rule     *rule;
-
-    for (var = u->context->variables;   var != NULL;   var = var->next) {
-        for (rule = var->rules;   rule != NULL;   rule = rule->next)
-            register_rule(rule, what, name, ptr);
-    }  /*  for var */
-}
-
-static void unregister_rule(struct pa_policy_context_rule *rule,
-                            enum pa_policy_object_type type,
-                            const char *name,
-                            void *ptr,
-                            unsigned long index)
-{
-    union  pa_policy_context_action    *actn;
-    struct pa_policy_set_property      *setprop;
-    struct pa_policy_del_property      *delprop;
-    struct pa_policy_object            *object;
-    int                                 lineno;
-
-    for (actn = rule->actions;  actn != NULL;  actn = actn->any.next) {
-
-        switch (actn->any.type) {
-
-        case pa_policy_set_property:
-            setprop = &actn->setprop;
-            lineno  = setprop->lineno;
-            object  = &setprop->object;
-            break;
-
-        case pa_policy_delete_property:
-            delprop = &actn->delprop;
-            lineno  = delprop->lineno;
-            object  = &delprop->object;
-            break;
-
-        default:
-            continue;
-        } /* switch */
-
-        unregister_object(object, type, name, ptr, index, lineno);
-
-    } /* for actn */
+    register_objects(&u->context->varobjs, what, name, ptr);
 }
 
 void pa_policy_context_unregister(struct userdata *u,
@@ -176,13 +146,11 @@ void pa_policy_context_unregister(struct userdata *u,
                                   void *ptr,
                                   unsigned long index)
 {
-    struct pa_policy_context_variable *var;
-    struct pa_policy_context_rule     *rule;
+    unregister_objects(&u->context->varobjs, type, name, ptr, index);
 
-    for (var = u->context->variables;   var != NULL;   var = var->next) {
-        for (rule = var->rules;   rule != NULL;   rule = rule->next)
-            unregister_rule(rule, type, name, ptr, index);
-    }  /* for var */
+    /* the object is going away; a held notification would outlive it */
+    if (ptr != NULL && u->context->dirty != NULL)
+        pa_hashmap_remove(u->context->dirty, ptr);
 }
 
 struct pa_policy_context_rule *
@@ -193,7 +161,10 @@ pa_policy_context_add_property_rule(struct userdata *u, const char *varname,
     struct pa_policy_context_rule     *rule;
 
     variable = add_variable(u->context, varname);
-    rule     = add_rule(&variable->rules, method, arg);
+    rule     = add_rule(&variable->rules, &u->context->varobjs, method, arg);
+
+    if (rule != NULL)
+        index_rule(variable, rule);
 
     return rule;
 }
@@ -220,6 +191,7 @@ pa_policy_context_add_property_action(struct pa_policy_context_rule *rule,
 
     setprop->object.type = obj_type;
     match_setup(&setprop->object.match, obj_classify, obj_name, NULL);
+    index_add_object(rule->objidx, &setprop->object, lineno);
 
     setprop->property = pa_xstrdup(prop_name);
 
@@ -249,6 +221,7 @@ pa_policy_context_delete_property_action(struct pa_policy_context_rule *rule,
 
     delprop->object.type = obj_type;
     match_setup(&delprop->object.match, obj_classify, obj_name, NULL);
+    index_add_object(rule->objidx, &delprop->object, lineno);
 
     delprop->property = pa_xstrdup(prop_name);
 
@@ -280,62 +253,241 @@ pa_policy_context_set_default_action(struct pa_policy_context_rule *rule,
 int pa_policy_context_variable_changed(struct userdata *u, const char *name,
                                        const char *value)
 {
+    struct pa_policy_context          *ctx;
     struct pa_policy_context_variable *var;
     struct pa_policy_context_rule     *rule;
-    union pa_policy_context_action    *actn;
+    struct pa_policy_rule_bucket      *rest;
+    struct pa_policy_rule_bucket      *equals;
+    int                                neq;
+    int                                i, j;
     int                                success;
 
+    pa_assert(u);
+    pa_assert_se((ctx = u->context));
+
     success = true;
 
-    for (var = u->context->variables;  var != NULL;  var = var->next) {
-        if (!strcmp(name, var->name)) {
-            if (!strcmp(value, var->value))
-                pa_log_debug("no value change -> no action");
-            else {
-                pa_xfree(var->value);
-                var->value = pa_xstrdup(value);
-
-                for (rule = var->rules;  rule != NULL;  rule = rule->next) {
-                    if (rule->match.method(value, &rule->match.arg)) {
-                        for (actn = rule->actions; actn; actn = actn->any.next)
-                        {
-                            if (u->context->variable_change_count == PA_POLICY_CONTEXT_MAX_CHANGES) {
-                                pa_log_warn("Max policy context value changes, dropping '%s':'%s'", name, value);
-                                return false;
-                            } else {
-                                u->context->variable_change[u->context->variable_change_count].action = actn;
-                                u->context->variable_change[u->context->variable_change_count].value = pa_xstrdup(value);
-                                u->context->variable_change_count++;
-                            }
-                        } /* for actn */
-                    } /* if rule */
-                } /* for rule */
+    if ((var = pa_hashmap_get(ctx->varidx, name)) != NULL) {
+        if (!strcmp(value, var->value))
+            pa_log_debug("no value change -> no action");
+        else {
+            pa_xfree(var->value);
+            var->value = pa_xstrdup(value);
+
+            /*
+             * the equals: rules for the value come from the index, only
+             * the rest of the rules are matched; the two are merged to
+             * keep the order of definition
+             */
+            rest   = &var->rest;
+            equals = var->equals ? pa_hashmap_get(var->equals, value) : NULL;
+            neq    = equals ? equals->nrule : 0;
+
+            for (i = j = 0;  i < neq || j < rest->nrule;  ) {
+                if (j >= rest->nrule ||
+                    (i < neq && equals->rules[i]->seq < rest->rules[j]->seq))
+                    log_rule_actions(ctx, equals->rules[i++], value);
+                else {
+                    rule = rest->rules[j++];
+
+                    if (rule->match.method(value, &rule->match.arg))
+                        log_rule_actions(ctx, rule, value);
+                }
             }
-            
-            break;
         }
-    } /* for var */
+    }
 
     return success;
 }
 
 void pa_policy_context_variable_commit(struct userdata *u)
 {
-    union pa_policy_context_action *action;
-    char *value;
+    struct pa_policy_context        *ctx;
+    struct pa_policy_context_change *change;
+    int                              i;
+
+    pa_assert(u);
+    pa_assert_se((ctx = u->context));
+
+    pa_policy_context_hold_notifications(u);
+
+    for (i = 0;  i < ctx->nchange;  i++) {
+        change = ctx->changes + i;
+
+        if (change->action != NULL && !perform_action(u, change->action,
+                                                      change->value))
+        {
+            pa_log("Failed to perform action for value %s",
+                   change->value ? change->value : "<constant>");
+        }
+    }
+
+    clear_changes(ctx);
+
+    pa_policy_context_flush_notifications(u);
+}
 
+void pa_policy_context_hold_notifications(struct userdata *u)
+{
     pa_assert(u);
     pa_assert(u->context);
 
-    while (u->context->variable_change_count) {
-        u->context->variable_change_count--;
+    u->context->hold++;
+}
+
+void pa_policy_context_proplist_changed(struct userdata           *u,
+                                        enum pa_policy_object_type type,
+                                        void                      *ptr)
+{
+    struct pa_policy_context *ctx;
+
+    pa_assert(u);
+    pa_assert_se((ctx = u->context));
+
+    if (ptr == NULL)
+        return;
+
+    if (!ctx->hold) {
+        fire_proplist_changed_hook(type, ptr);
+        return;
+    }
+
+    if (ctx->dirty == NULL) {
+        ctx->dirty = pa_hashmap_new(pa_idxset_trivial_hash_func,
+                                    pa_idxset_trivial_compare_func);
+    }
+
+    pa_hashmap_put(ctx->dirty, ptr, PA_UINT32_TO_PTR(type));
+}
+
+void pa_policy_context_flush_notifications(struct userdata *u)
+{
+    struct pa_policy_context *ctx;
+    const void               *ptr;
+    void                     *type;
+    void                     *state;
+
+    pa_assert(u);
+    pa_assert_se((ctx = u->context));
+    pa_assert(ctx->hold > 0);
+
+    if (--ctx->hold > 0 || ctx->dirty == NULL)
+        return;
+
+    /*
+     * Take the entries one by one: a hook may unregister an object that
+     * is still waiting, which drops its entry. Properties the hooks
+     * change are sent right away as nothing is held any more.
+     */
+    for (;;) {
+        state = NULL;
+
+        if ((type = pa_hashmap_iterate(ctx->dirty, &state, &ptr)) == NULL)
+            break;
+
+        pa_hashmap_remove(ctx->dirty, ptr);
+        fire_proplist_changed_hook(PA_PTR_TO_UINT32(type), (void *)ptr);
+    }
+}
+
+static void log_rule_actions(struct pa_policy_context      *ctx,
+                             struct pa_policy_context_rule *rule,
+                             const char                    *value)
+{
+    union pa_policy_context_action *actn;
+
+    for (actn = rule->actions;  actn != NULL;  actn = actn->any.next)
+        log_change(ctx, actn, value);
+}
+
+static void log_change(struct pa_policy_context       *ctx,
+                       union pa_policy_context_action *action,
+                       const char                     *value)
+{
+    struct pa_policy_context_change *change;
+    pa_hashmap                      *props;
+    const void                      *target;
+    const char                      *prop;
+    void                            *slot;
+    int                              copy;
+
+    /*
+     * the writes of a transaction are merged per (object, property):
+     * a later write supersedes the earlier one and takes its place
+     * at the end of the log, so only the final value gets written
+     */
+    switch (action->any.type) {
+
+    case pa_policy_set_property:
+        target = action->setprop.object.ptr;
+        target = target ? target : (void *)&action->setprop.object;
+        prop   = action->setprop.property;
+        copy   = action->setprop.value.type == pa_policy_value_copy;
+        break;
+
+    case pa_policy_delete_property:
+        target = action->delprop.object.ptr;
+        target = target ? target : (void *)&action->delprop.object;
+        prop   = action->delprop.property;
+        copy   = false;
+        break;
+
+    case pa_policy_set_default:
+        target = action->setdef.var;
+        prop   = "";
+        copy   = false;
+        break;
+
+    default:
+        return;
+    }
+
+    if (ctx->pending == NULL) {
+        ctx->pending = pa_hashmap_new_full(pa_idxset_trivial_hash_func,
+                                           pa_idxset_trivial_compare_func,
+                                           NULL,
+                                           (pa_free_cb_t) pa_hashmap_free);
+    }
+
+    if ((props = pa_hashmap_get(ctx->pending, target)) == NULL) {
+        props = pa_hashmap_new(pa_idxset_string_hash_func,
+                               pa_idxset_string_compare_func);
+        pa_hashmap_put(ctx->pending, (void *)target, props);
+    }
+
+    if ((slot = pa_hashmap_remove(props, prop)) != NULL) {
+        change = ctx->changes + (PA_PTR_TO_UINT32(slot) - 1);
+
+        pa_xfree(change->value);
+        change->action = NULL;
+        change->value  = NULL;
+    }
+
+    if (ctx->nchange >= ctx->maxchange) {
+        ctx->maxchange = ctx->maxchange ? ctx->maxchange * 2 : 16;
+        ctx->changes   = pa_xrenew(struct pa_policy_context_change,
+                                   ctx->changes, ctx->maxchange);
+    }
+
+    change = ctx->changes + ctx->nchange++;
+    change->action = action;
+    change->value  = copy ? pa_xstrdup(value) : NULL;
 
-        action = u->context->variable_change[u->context->variable_change_count].action;
-        value  = u->context->variable_change[u->context->variable_change_count].value;
+    pa_hashmap_put(props, (void *)prop, PA_UINT32_TO_PTR(ctx->nchange));
+}
+
+static void clear_changes(struct pa_policy_context *ctx)
+{
+    int i;
+
+    for (i = 0;  i < ctx->nchange;  i++)
+        pa_xfree(ctx->changes[i].value);
 
-        if (!perform_action(u, action, value))
-            pa_log("Failed to perform action for value %s", value);
-        pa_xfree(value);
+    ctx->nchange = 0;
+
+    if (ctx->pending != NULL) {
+        pa_hashmap_free(ctx->pending);
+        ctx->pending = NULL;
     }
 }
 
@@ -346,15 +498,13 @@ struct pa_policy_context_variable *add_variable(struct pa_policy_context *ctx,
     struct pa_policy_context_variable *var;
     struct pa_policy_context_variable *last;
 
+    if ((var = pa_hashmap_get(ctx->varidx, name)) != NULL)
+        return var;
+
     for (last = (struct pa_policy_context_variable *)&ctx->variables;
          last->next != NULL;
          last = last->next)
-    {
-        var = last->next;
-
-        if (!strcmp(name, var->name))
-            return var;
-    }
+        ;
 
     var = pa_xmalloc0(sizeof(*var));
 
@@ -363,6 +513,8 @@ struct pa_policy_context_variable *add_variable(struct pa_policy_context *ctx,
 
     last->next = var;
 
+    pa_hashmap_put(ctx->varidx, var->name, var);
+
     pa_log_debug("created context variable '%s'", var->name);
 
     return var;
@@ -412,6 +564,13 @@ static void delete_variable(struct pa_policy_context          *ctx,
             pa_log_debug("delete context variable '%s'", variable->name);
 #endif
 
+            if (ctx->varidx != NULL)
+                pa_hashmap_remove(ctx->varidx, variable->name);
+
+            if (variable->equals != NULL)
+                pa_hashmap_free(variable->equals);
+            pa_xfree(variable->rest.rules);
+
             pa_xfree(variable->name);
 
             while (variable->rules != NULL)
@@ -427,8 +586,56 @@ static void delete_variable(struct pa_policy_context          *ctx,
            __FUNCTION__);
 }
 
+static void index_rule(struct pa_policy_context_variable *var,
+                       struct pa_policy_context_rule     *rule)
+{
+    struct pa_policy_rule_bucket *bucket;
+    const char                   *value;
+
+    rule->seq = var->nrule++;
+
+    if (rule->match.method != pa_classify_method_equals)
+        bucket = &var->rest;
+    else {
+        value = rule->match.arg.string;
+
+        if (var->equals == NULL) {
+            var->equals = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                              pa_idxset_string_compare_func,
+                                              NULL,
+                                              (pa_free_cb_t) rule_bucket_free);
+        }
+
+        if ((bucket = pa_hashmap_get(var->equals, value)) == NULL) {
+            bucket = pa_xnew0(struct pa_policy_rule_bucket, 1);
+            bucket->key = pa_xstrdup(value);
+            pa_hashmap_put(var->equals, bucket->key, bucket);
+        }
+    }
+
+    rule_bucket_append(bucket, rule);
+}
+
+static void rule_bucket_append(struct pa_policy_rule_bucket  *bucket,
+                               struct pa_policy_context_rule *rule)
+{
+    bucket->rules = pa_xrenew(struct pa_policy_context_rule *,
+                              bucket->rules, bucket->nrule + 1);
+    bucket->rules[bucket->nrule++] = rule;
+}
+
+static void rule_bucket_free(struct pa_policy_rule_bucket *bucket)
+{
+    if (bucket != NULL) {
+        pa_xfree(bucket->rules);
+        pa_xfree(bucket->key);
+        pa_xfree(bucket);
+    }
+}
+
 static struct pa_policy_context_rule *
 add_rule(struct pa_policy_context_rule    **rules,
+         struct pa_policy_object_index     *objidx,
          enum pa_classify_method            method,
          const char                        *arg)
 {
@@ -443,6 +650,8 @@ add_rule(struct pa_policy_context_rule    **rules,
         return NULL;
     };
 
+    rule->objidx = objidx;
+
     for (last = (struct pa_policy_context_rule *)rules;
          last->next != NULL;
          last = last->next)
@@ -595,7 +804,8 @@ static int perform_action(struct userdata                *u,
                                  objtype, objname, setprop->property,
                                  prop_value);
 
-                    set_object_property(object, setprop->property, prop_value);
+                    set_object_property(u, object, setprop->property,
+                                        prop_value);
                 }
 
                 /* Forward shared strings */
@@ -619,7 +829,7 @@ static int perform_action(struct userdata                *u,
             pa_log_debug("deleting %s '%s' property '%s'",
                          objtype, objname, delprop->property);
             
-            delete_object_property(object, delprop->property);
+            delete_object_property(u, object, delprop->property);
         }
         break;
 
@@ -667,7 +877,7 @@ static int match_setup(struct pa_policy_match  *match,
         break;
 
     case pa_method_matches:
-        if (regcomp(&match->arg.rexp, arg, 0) == 0) {
+        if (pa_classify_regex_compile(&match->arg.regex, arg) == 0) {
             match->method = pa_classify_method_matches;
             break;
         }
@@ -690,7 +900,7 @@ static int match_setup(struct pa_policy_match  *match,
 static void match_cleanup(struct pa_policy_match *match)
 {
     if (match->method == pa_classify_method_matches)
-        regfree(&match->arg.rexp);
+        pa_classify_regex_free(&match->arg.regex);
     else
         pa_xfree((void *)match->arg.string);
 
@@ -751,11 +961,56 @@ static void value_cleanup(union pa_policy_value *value)
     }
 }
 
-static void register_object(struct pa_policy_object *object,
-                            enum pa_policy_object_type type,
-                            const char *name, void *ptr, int lineno)
+static void index_add_object(struct pa_policy_object_index *idx,
+                             struct pa_policy_object       *object,
+                             int                            lineno)
 {
-    const char    *type_str;
+    const char *equals = NULL;
+
+    pa_assert(idx);
+
+    if (object->match.method == NULL)
+        return;
+
+    if (object->match.method == pa_classify_method_equals)
+        equals = object->match.arg.string;
+
+    pa_policy_object_index_add(idx, object->type, equals, object, lineno);
+}
+
+static void register_objects(struct pa_policy_object_index *idx,
+                             enum pa_policy_object_type     type,
+                             const char                    *name,
+                             void                          *ptr)
+{
+    struct object_visit visit = { type, name, ptr, 0 };
+
+    pa_policy_object_index_visit_name(idx, type, name,
+                                      register_object, &visit);
+}
+
+static void unregister_objects(struct pa_policy_object_index *idx,
+                               enum pa_policy_object_type     type,
+                               const char                    *name,
+                               void                          *ptr,
+                               unsigned long                  index)
+{
+    struct object_visit visit = { type, name, ptr, index };
+
+    /*
+     * the name might have changed since the registration, so
+     * all the objects of the type are visited, not only the bucket
+     */
+    pa_policy_object_index_visit_all(idx, type, unregister_object, &visit);
+}
+
+static void register_object(struct pa_policy_object *object, int lineno,
+                            void *userdata)
+{
+    struct object_visit        *visit = userdata;
+    enum pa_policy_object_type  type  = visit->type;
+    const char                 *name  = visit->name;
+    const char                 *type_str;
 
     if (object->type == type && object->match.method(name,&object->match.arg)){
 
@@ -769,26 +1024,26 @@ static void register_object(struct pa_policy_object *object,
             pa_log_debug("registering context-rule for %s '%s' "
                          "(line %d in config file)", type_str, name, lineno);
 
-            object->ptr   = ptr;
-            object->index = object_index(type, ptr);
+            object->ptr   = visit->ptr;
+            object->index = object_index(type, visit->ptr);
 
         }
     }
 }
 
-static void unregister_object(struct pa_policy_object *object,
-                              enum pa_policy_object_type type,
-                              const char *name,
-                              void *ptr,
-                              unsigned long index,
-                              int lineno)
+static void unregister_object(struct pa_policy_object *object, int lineno,
+                              void *userdata)
 {
-    if (( ptr &&                ptr == object->ptr             ) ||
-        (!ptr && type == object->type && index == object->index)   ) {
+    struct object_visit *visit = userdata;
+    void                *ptr   = visit->ptr;
+
+    if (( ptr &&                      ptr == object->ptr             ) ||
+        (!ptr && visit->type == object->type &&
+                                visit->index == object->index)         ) {
 
         pa_log_debug("unregistering context-rule for %s '%s' "
                      "(line %d in config file)",
-                     object_type_str(object->type), name, lineno);
+                     object_type_str(object->type), visit->name, lineno);
 
         object->ptr   = NULL;
         object->index = PA_IDXSET_INVALID;
@@ -817,7 +1072,8 @@ static const char *get_object_property(struct pa_policy_object *object,
     return value;
 }
 
-static void set_object_property(struct pa_policy_object *object,
+static void set_object_property(struct userdata *u,
+                                struct pa_policy_object *object,
                                 const char *property, const char *value)
 {
     pa_proplist *proplist;
@@ -825,12 +1081,13 @@ static void set_object_property(struct pa_policy_object *object,
     if (object->ptr != NULL) {
         if ((proplist = get_object_proplist(object)) != NULL) {
             pa_proplist_sets(proplist, property, value);
-            fire_object_property_changed_hook(object);
+            pa_policy_context_proplist_changed(u, object->type, object->ptr);
         }
     }
 }
 
-static void delete_object_property(struct pa_policy_object *object,
+static void delete_object_property(struct userdata *u,
+                                   struct pa_policy_object *object,
                                    const char *property)
 {
     pa_proplist *proplist;
@@ -838,7 +1095,7 @@ static void delete_object_property(struct pa_policy_object *object,
     if (object->ptr != NULL) {
         if ((proplist = get_object_proplist(object)) != NULL) {
             pa_proplist_unset(proplist, property);
-            fire_object_property_changed_hook(object);
+            pa_policy_context_proplist_changed(u, object->type, object->ptr);
         }
     }
 }
@@ -957,46 +1214,58 @@ static const char *object_name(struct pa_policy_object *object)
     return name;
 }
 
-static void fire_object_property_changed_hook(struct pa_policy_object *object)
+static void fire_proplist_changed_hook(enum pa_policy_object_type type,
+                                       void *ptr)
 {
-    pa_core                 *core;
-    pa_core_hook_t           hook;
-    struct pa_sink          *sink;
-    struct pa_source        *src;
-    struct pa_sink_input    *sinp;
-    struct pa_source_output *sout;
+    pa_core                     *core;
+    pa_core_hook_t               hook;
+    pa_subscription_event_type_t event;
+    uint32_t                     index;
+    struct pa_sink              *sink;
+    struct pa_source            *src;
+    struct pa_sink_input        *sinp;
+    struct pa_source_output     *sout;
 
-   switch (object->type) {
+    switch (type) {
 
     case pa_policy_object_sink:
-        sink = object->ptr;
-        core = sink->core;
-        hook = PA_CORE_HOOK_SINK_PROPLIST_CHANGED;
+        sink  = ptr;
+        core  = sink->core;
+        hook  = PA_CORE_HOOK_SINK_PROPLIST_CHANGED;
+        event = PA_SUBSCRIPTION_EVENT_SINK;
+        index = sink->index;
         break;
         
     case pa_policy_object_source:
-        src  = object->ptr;
-        core = src->core;
-        hook = PA_CORE_HOOK_SOURCE_PROPLIST_CHANGED;
+        src   = ptr;
+        core  = src->core;
+        hook  = PA_CORE_HOOK_SOURCE_PROPLIST_CHANGED;
+        event = PA_SUBSCRIPTION_EVENT_SOURCE;
+        index = src->index;
         break;
         
     case pa_policy_object_sink_input:
-        sinp = object->ptr;
-        core = sinp->core;
-        hook = PA_CORE_HOOK_SINK_INPUT_PROPLIST_CHANGED;
+        sinp  = ptr;
+        core  = sinp->core;
+        hook  = PA_CORE_HOOK_SINK_INPUT_PROPLIST_CHANGED;
+        event = PA_SUBSCRIPTION_EVENT_SINK_INPUT;
+        index = sinp->index;
         break;
         
     case pa_policy_object_source_output:
-        sout = object->ptr;
-        core = sout->core;
-        hook = PA_CORE_HOOK_SOURCE_OUTPUT_PROPLIST_CHANGED;
+        sout  = ptr;
+        core  = sout->core;
+        hook  = PA_CORE_HOOK_SOURCE_OUTPUT_PROPLIST_CHANGED;
+        event = PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT;
+        index = sout->index;
         break;
         
     default:
         return;
     }
 
-   pa_hook_fire(&core->hooks[hook], object->ptr);
+    pa_subscription_post(core, event | PA_SUBSCRIPTION_EVENT_CHANGE, index);
+    pa_hook_fire(&core->hooks[hook], ptr);
 }
 
 static unsigned long object_index(enum pa_policy_object_type type, void *ptr)
@@ -1078,7 +1347,10 @@ pa_policy_activity_add_active_rule(struct userdata *u, const char *device,
     struct pa_policy_context_rule      *rule;
 
     pa_assert_se((variable = get_activity_variable(u, u->context, device)));
-    rule = add_rule(&variable->active_rules, method, sink_name);
+    rule = add_rule(&variable->active_rules, &u->context->actobjs,
+                    method, sink_name);
+
+    flush_activity_sinks(u->context);
 
     return rule;
 }
@@ -1091,30 +1363,126 @@ pa_policy_activity_add_inactive_rule(struct userdata *u, const char *device,
     struct pa_policy_context_rule      *rule;
 
     pa_assert_se((variable = get_activity_variable(u, u->context, device)));
-    rule = add_rule(&variable->inactive_rules, method, sink_name);
+    rule = add_rule(&variable->inactive_rules, &u->context->actobjs,
+                    method, sink_name);
+
+    flush_activity_sinks(u->context);
 
     return rule;
 }
 
+static struct pa_policy_activity_sink *
+get_activity_sink(struct pa_policy_context *ctx, const char *name)
+{
+    struct pa_policy_activity_sink     *as;
+    struct pa_policy_activity_variable *var;
+    struct pa_policy_context_rule      *rule;
+    struct pa_policy_activity_match    *m;
+    int                                 opened;
+
+    /*
+     * the rules matching a sink name are looked up once, when the
+     * name is first seen, and dropped when the sink goes away; rules
+     * are only added at config load and that throws away what was
+     * looked up so far
+     */
+    if (ctx->actsinks == NULL) {
+        ctx->actsinks = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                            pa_idxset_string_compare_func,
+                                            NULL,
+                                            (pa_free_cb_t) activity_sink_free);
+    }
+
+    if ((as = pa_hashmap_get(ctx->actsinks, name)) != NULL)
+        return as;
+
+    as = pa_xnew0(struct pa_policy_activity_sink, 1);
+    as->name = pa_xstrdup(name);
+
+    for (var = ctx->activities;  var != NULL;  var = var->next) {
+        for (opened = 1;  opened >= 0;  opened--) {
+            rule = opened ? var->active_rules : var->inactive_rules;
+
+            for ( ;  rule != NULL;  rule = rule->next) {
+                if (!rule->match.method(name, &rule->match.arg))
+                    continue;
+
+                as->matches = pa_xrenew(struct pa_policy_activity_match,
+                                        as->matches, as->nmatch + 1);
+                m = as->matches + as->nmatch++;
+
+                m->var    = var;
+                m->rule   = rule;
+                m->opened = opened;
+            }
+        }
+    }
+
+    pa_hashmap_put(ctx->actsinks, as->name, as);
+
+    return as;
+}
+
+static void activity_sink_free(struct pa_policy_activity_sink *as)
+{
+    if (as != NULL) {
+        pa_xfree(as->matches);
+        pa_xfree(as->name);
+        pa_xfree(as);
+    }
+}
+
+static void drop_activity_sink(struct pa_policy_context *ctx,
+                               const char               *name)
+{
+    if (ctx->actsinks != NULL && name != NULL)
+        activity_sink_free(pa_hashmap_remove(ctx->actsinks, name));
+}
+
+static void flush_activity_sinks(struct pa_policy_context *ctx)
+{
+    if (ctx->actsinks != NULL) {
+        pa_hashmap_free(ctx->actsinks);
+        ctx->actsinks = NULL;
+    }
+}
+
+static int has_activity_match(struct pa_policy_activity_sink     *as,
+                              struct pa_policy_activity_variable *var)
+{
+    int i;
+
+    for (i = 0;  i < as->nmatch;  i++) {
+        if (as->matches[i].var == var)
+            return true;
+    }
+
+    return false;
+}
+
 /* force_state can be -1  - do not force , 0 force inactive, 1 force active */
-static int perform_activity_action(pa_sink *sink, struct pa_policy_activity_variable *var, int force_state) {
-    struct pa_policy_context_rule     *rule;
+static int perform_activity_action(pa_sink *sink,
+                                   struct pa_policy_activity_sink *as,
+                                   struct pa_policy_activity_variable *var,
+                                   int force_state) {
+    struct pa_policy_activity_match   *m;
     union pa_policy_context_action    *actn;
     int                                is_opened;
+    int                                i;
 
     pa_assert(sink);
+    pa_assert(as);
 
     if ((force_state != -1 && force_state == 1) ||
-        (force_state == -1 && PA_SINK_IS_OPENED(pa_sink_get_state(sink)))) {
-        rule = var->active_rules;
+        (force_state == -1 && PA_SINK_IS_OPENED(pa_sink_get_state(sink))))
         is_opened = 1;
-    } else {
-        rule = var->inactive_rules;
+    else
         is_opened = 0;
-    }
 
-    for ( ;  rule != NULL;  rule = rule->next) {
-        if (rule->match.method(sink->name, &rule->match.arg)) {
+    for (i = 0;  i < as->nmatch;  i++) {
+        m = as->matches + i;
+
+        if (m->var == var && m->opened == is_opened) {
 
             if (force_state == -1 && var->sink_opened != -1 && var->sink_opened == is_opened) {
                 pa_log_debug("Already executed actions for state change, skip.");
@@ -1123,7 +1491,7 @@ static int perform_activity_action(pa_sink *sink, struct pa_policy_activity_vari
 
             var->sink_opened = is_opened;
 
-            for (actn = rule->actions; actn; actn = actn->any.next)
+            for (actn = m->rule->actions; actn; actn = actn->any.next)
             {
                 if (!perform_action(var->userdata, actn, NULL))
                     pa_log("Failed to perform activity action.");
@@ -1134,42 +1502,72 @@ static int perform_activity_action(pa_sink *sink, struct pa_policy_activity_vari
     return 1;
 }
 
-static pa_hook_result_t sink_state_changed_cb(pa_core *c, pa_object *o, struct pa_policy_activity_variable *var) {
-    pa_sink *sink;
+static pa_hook_result_t sink_state_changed_cb(pa_core *c, pa_object *o, struct userdata *u) {
+    struct pa_policy_activity_sink     *as;
+    struct pa_policy_activity_variable *var;
+    pa_sink                            *sink;
+    int                                 i;
 
     pa_assert(c);
     pa_object_assert_ref(o);
-    pa_assert(var);
+    pa_assert(u);
 
     if (pa_sink_isinstance(o)) {
         sink = PA_SINK(o);
-        perform_activity_action(sink, var, var->default_state);
+        as   = get_activity_sink(u->context, sink->name);
+
+        /* the matches are grouped by variable */
+        for (i = 0, var = NULL;  i < as->nmatch;  i++) {
+            if (as->matches[i].var == var)
+                continue;
+
+            var = as->matches[i].var;
+
+            if (var->active)
+                perform_activity_action(sink, as, var, var->default_state);
+        }
+
+        /* the entry was dropped at unlink; do not bring it back */
+        if (!PA_SINK_IS_LINKED(pa_sink_get_state(sink)))
+            drop_activity_sink(u->context, sink->name);
     }
 
     return PA_HOOK_OK;
 }
 
 static void apply_activity(struct userdata *u, struct pa_policy_activity_variable *var) {
+    struct pa_policy_activity_sink     *as;
     pa_sink                            *sink;
     uint32_t                            idx = 0;
 
     pa_assert(u);
     pa_assert(var);
 
-    PA_IDXSET_FOREACH(sink, u->core->sinks, idx)
-        perform_activity_action(sink, var, var->default_state);
+    PA_IDXSET_FOREACH(sink, u->core->sinks, idx) {
+        as = get_activity_sink(u->context, sink->name);
+
+        if (has_activity_match(as, var))
+            perform_activity_action(sink, as, var, var->default_state);
+    }
 }
 
 static void enable_activity(struct userdata *u, struct pa_policy_activity_variable *var) {
+    struct pa_policy_context *ctx;
+
     pa_assert(u);
     pa_assert(var);
+    pa_assert_se((ctx = u->context));
 
-    if (var->sink_state_changed_hook_slot)
+    if (var->active)
         return;
 
-    var->sink_state_changed_hook_slot = pa_hook_connect(&u->core->hooks[PA_CORE_HOOK_SINK_STATE_CHANGED],
-                                                        PA_HOOK_EARLY,
-                                                        (pa_hook_cb_t) sink_state_changed_cb, var);
+    var->active = true;
+
+    if (ctx->nactive++ == 0) {
+        ctx->sink_state_changed_hook_slot = pa_hook_connect(&u->core->hooks[PA_CORE_HOOK_SINK_STATE_CHANGED],
+                                                            PA_HOOK_EARLY,
+                                                            (pa_hook_cb_t) sink_state_changed_cb, u);
+    }
 
     var->sink_opened = -1;
     pa_log_debug("enabling activity for %s", var->device);
@@ -1177,18 +1575,25 @@ static void enable_activity(struct userdata *u, struct pa_policy_activity_variab
 }
 
 static void disable_activity(struct userdata *u, struct pa_policy_activity_variable *var) {
+    struct pa_policy_context *ctx;
+
     pa_assert(u);
     pa_assert(var);
+    pa_assert_se((ctx = u->context));
 
-    if (!var->sink_state_changed_hook_slot)
+    if (!var->active)
         return;
 
     var->sink_opened = -1;
     pa_log_debug("disabling activity for %s", var->device);
     apply_activity(u, var);
 
-    pa_hook_slot_free(var->sink_state_changed_hook_slot);
-    var->sink_state_changed_hook_slot = NULL;
+    var->active = false;
+
+    if (--ctx->nactive == 0) {
+        pa_hook_slot_free(ctx->sink_state_changed_hook_slot);
+        ctx->sink_state_changed_hook_slot = NULL;
+    }
 }
 
 int pa_policy_activity_device_changed(struct userdata *u, const char *device)
@@ -1210,15 +1615,7 @@ void pa_policy_activity_register(struct userdata *u,
                                  enum pa_policy_object_type type,
                                  const char *name, void *ptr)
 {
-    struct pa_policy_activity_variable *var;
-    struct pa_policy_context_rule      *rule;
-
-    for (var = u->context->activities;   var != NULL;   var = var->next) {
-        for (rule = var->active_rules;   rule != NULL;   rule = rule->next)
-            register_rule(rule, type, name, ptr);
-        for (rule = var->inactive_rules;   rule != NULL;   rule = rule->next)
-            register_rule(rule, type, name, ptr);
-    }  /*  for var */
+    register_objects(&u->context->actobjs, type, name, ptr);
 }
 
 void pa_policy_activity_unregister(struct userdata *u,
@@ -1227,15 +1624,11 @@ void pa_policy_activity_unregister(struct userdata *u,
                                    void *ptr,
                                    unsigned long index)
 {
-    struct pa_policy_activity_variable *var;
-    struct pa_policy_context_rule      *rule;
+    unregister_objects(&u->context->actobjs, type, name, ptr, index);
 
-    for (var = u->context->activities;   var != NULL;   var = var->next) {
-        for (rule = var->active_rules;   rule != NULL;   rule = rule->next)
-            unregister_rule(rule, type, name, ptr, index);
-        for (rule = var->inactive_rules;   rule != NULL;   rule = rule->next)
-            unregister_rule(rule, type, name, ptr, index);
-    }  /* for var */
+    /* sink names of hot-plugged devices come and go */
+    if (type == pa_policy_object_sink && ptr != NULL)
+        drop_activity_sink(u->context, ((pa_sink *)ptr)->name);
 }
 
 /*
@@ -2,8 +2,7 @@
 #define foopolicycontextfoo
 
 #include "classify.h"
-
-#define PA_POLICY_CONTEXT_MAX_CHANGES (16)
+#include "object-index.h"
 
 enum pa_policy_action_type {
     pa_policy_action_unknown = 0,
@@ -16,20 +15,6 @@ enum pa_policy_action_type {
     pa_policy_action_max
 };
 
-enum pa_policy_object_type {
-    pa_policy_object_unknown = 0,
-    pa_policy_object_min = pa_policy_object_unknown,
-
-    pa_policy_object_module,
-    pa_policy_object_card,
-    pa_policy_object_sink,
-    pa_policy_object_source,
-    pa_policy_object_sink_input,
-    pa_policy_object_source_output,
-
-    pa_policy_object_max
-};
-
 enum pa_policy_value_type {
     pa_policy_value_unknown = 0,
     pa_policy_value_min = pa_policy_value_unknown,
@@ -108,6 +93,14 @@ struct pa_policy_context_rule {
     struct pa_policy_context_rule      *next;
     struct pa_policy_match              match; /* for the variable value */
     union pa_policy_context_action     *actions;
+    struct pa_policy_object_index      *objidx; /* where the action objects go */
+    int                                 seq;    /* order within the variable */
+};
+
+struct pa_policy_rule_bucket {
+    char                               *key;
+    struct pa_policy_context_rule     **rules; /* in the order of definition */
+    int                                 nrule;
 };
 
 struct pa_policy_context_variable {
@@ -115,6 +108,9 @@ struct pa_policy_context_variable {
     char                               *name;
     char                               *value;
     struct pa_policy_context_rule      *rules;
+    int                                 nrule;
+    pa_hashmap                         *equals; /* value => rule bucket */
+    struct pa_policy_rule_bucket        rest;   /* startswith/matches/true */
 };
 
 struct pa_policy_activity_rule {
@@ -129,22 +125,46 @@ struct pa_policy_activity_variable {
     struct pa_policy_context_rule      *active_rules;
     struct pa_policy_context_rule      *inactive_rules;
     struct userdata                    *userdata;
-    /* activity variable is active if hook slot pointer is not-null */
-    pa_hook_slot                       *sink_state_changed_hook_slot;
+    int                                 active;
     int                                 default_state; /* -1 select based on sink running/suspended,
                                                           1 active, 0 inactive */
     /* cache some values when variable is active */
     int                                 sink_opened; /* -1 not set, 0 closed, 1 opened */
 };
 
+struct pa_policy_activity_match {
+    struct pa_policy_activity_variable *var;
+    struct pa_policy_context_rule      *rule;
+    int                                 opened; /* 1 active, 0 inactive rule */
+};
+
+struct pa_policy_activity_sink {
+    char                               *name;
+    struct pa_policy_activity_match    *matches; /* grouped by variable */
+    int                                 nmatch;
+};
+
+struct pa_policy_context_change {
+    union pa_policy_context_action     *action; /* NULL if superseded */
+    char                               *value;  /* only for value copies */
+};
+
 struct pa_policy_context {
     struct pa_policy_context_variable  *variables;
+    pa_hashmap                         *varidx;  /* name => variable */
     struct pa_policy_activity_variable *activities;
-    struct variable_change {
-        union pa_policy_context_action *action;
-        char                            *value;
-    } variable_change[PA_POLICY_CONTEXT_MAX_CHANGES];
-    int                                 variable_change_count;
+    struct pa_policy_object_index       varobjs; /* objects of variable rules */
+    struct pa_policy_object_index       actobjs; /* objects of activity rules */
+    struct pa_policy_context_change    *changes; /* in the order of arrival */
+    int                                 nchange;
+    int                                 maxchange;
+    pa_hashmap                         *pending; /* target => prop => change */
+    pa_hashmap                         *dirty;   /* object => type */
+    int                                 hold;    /* notifications on hold */
+    pa_hashmap                         *actsinks; /* sink name => matches */
+    int                                 nactive;  /* enabled activities */
+    /* shared by the enabled activities, connected while there is any */
+    pa_hook_slot                       *sink_state_changed_hook_slot;
 };
 
 
@@ -185,6 +205,14 @@ int pa_policy_context_variable_changed(struct userdata *u, const char *name, con
  * values with pa_policy_context_variable_changed() */
 void pa_policy_context_variable_commit(struct userdata *u);
 
+/* proplist changes of policy objects. while held, the notifications are
+ * collected and sent once per object when the outermost hold is flushed */
+void pa_policy_context_hold_notifications(struct userdata *u);
+void pa_policy_context_proplist_changed(struct userdata *u,
+                                        enum pa_policy_object_type type,
+                                        void *ptr);
+void pa_policy_context_flush_notifications(struct userdata *u);
+
 /* device       - device mode, bta2dp, bthsp, etc.
  * sink_name    - active sink on device mode, matched with method & arg
  */
@@ -6,6 +6,7 @@
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <pulse/rtclock.h>
 #include <pulsecore/dbus-shared.h>
 #include <pulsecore/core-util.h>
 
@@ -18,6 +19,7 @@
 #include "source-ext.h"
 #include "card-ext.h"
 #include "sink-input-ext.h"
+#include "action-names.h"
 
 #define ADMIN_DBUS_MANAGER          "org.freedesktop.DBus"
 #define ADMIN_DBUS_PATH             "/org/freedesktop/DBus"
@@ -46,8 +48,26 @@
 
 #define STRUCT_OFFSET(s,m) ((char *)&(((s *)0)->m) - (char *)0)
 
+/* descriptor tables are indexed by the id of the action or argument name */
+#define ACTION(n)   pa_policy_action_id_##n
+#define ACTION_MAX  pa_policy_action_id_max
+#define ARG(n)      pa_policy_argument_id_##n
+#define ARG_MAX     pa_policy_argument_id_max
+
 #define MAX_ROUTING_DECISIONS 2
 
+/*
+ * PA's D-Bus glue dispatches one message per main loop iteration, so
+ * a burst of action signals is recognised by the gaps between them.
+ */
+#define COALESCE_WINDOW  (5 * PA_USEC_PER_MSEC)  /* quiet time to wait */
+#define COALESCE_LIMIT   (20 * PA_USEC_PER_MSEC) /* longest delay of a txn */
+
+#define PROP_DECISIONS_UNCHANGED    "policy.decisions.unchanged"
+
+#define FINGERPRINT_INIT  0xcbf29ce484222325ULL    /* FNV-1a 64 bit */
+#define FINGERPRINT_PRIME 0x100000001b3ULL
+
 struct routing_decision {      /* temporary storage for routing decision information */
     enum pa_policy_route_class class;
     char *target;
@@ -55,6 +75,43 @@ struct routing_decision {      /* temporary storage for routing decision informa
     char *hwid;
 };
 
+struct route_state {            /* currently applied route of a class */
+    char               *target;
+    char               *mode;
+    char               *hwid;
+};
+
+struct decision_value {         /* group or device decision */
+    char               *name;
+    int                 value;
+};
+
+struct context_change {         /* context variable change */
+    char               *variable;
+    char               *value;
+};
+
+struct decision_set {           /* decisions waiting to be applied */
+    struct routing_decision route[pa_policy_route_max]; /* by route class */
+    pa_hashmap         *limit;   /* group => volume limit */
+    pa_hashmap         *cork;    /* group => corked or not */
+    pa_hashmap         *mute;    /* device => muted or not */
+    struct context_change *context; /* in the order of arrival */
+    int                 ncontext;
+    int                 maxcontext;
+};
+
+struct decision_bytes {         /* serialized decision set */
+    uint8_t            *data;
+    size_t              len;
+    size_t              size;
+};
+
+struct txn_status {             /* transaction waiting for its status */
+    uint32_t            txid;
+    int                 success;
+};
+
 struct pa_policy_dbusif {
     pa_dbus_connection *conn;
     DBusPendingCall    *pending_pdp_registration;
@@ -66,17 +123,30 @@ struct pa_policy_dbusif {
     char               *actrule; /* match rule to catch action signals */
     char               *strrule; /* match rule to catch stream info signals */
     int                 regist;  /* wheter or not registered to policy daemon*/
+    struct route_state  route[pa_policy_route_max]; /* by route class */
+    pa_mainloop_api    *mainloop;
+    int                 coalesce; /* apply once the action burst is over */
+    pa_time_event      *timer;    /* applies the coalesced decisions */
+    pa_usec_t           first;    /* arrival of the oldest queued txn */
+    struct decision_set pending;  /* decisions of the queued transactions */
+    struct txn_status  *txns;     /* the queued transactions */
+    int                 ntxn;
+    int                 maxtxn;
+    uint64_t            fingerprint; /* of the last applied decision set */
+    struct decision_bytes last;      /* the last applied set itself */
+    struct decision_bytes current;   /* the set being applied */
+    int                 applied;     /* whether last is valid */
+    uint32_t            unchanged;   /* decision sets found unchanged */
 };
 
 struct actdsc {                 /* action descriptor */
-    const char         *name;
-    int               (*parser)(struct userdata *u, DBusMessageIter *iter);
+    int               (*parser)(struct userdata *u, DBusMessageIter *iter,
+                                struct decision_set *set);
 };
 
 struct argdsc {                 /* argument descriptor for actions */
-    const char         *name;
     int                 offs;
-    int                 type;
+    int                 type;   /* DBUS_TYPE_INVALID if not an argument */
 };
 
 struct argrt {                  /* audio_route arguments */
@@ -106,12 +176,36 @@ struct argctx {                 /* context arguments */
     char               *value;
 };
 
+static struct actdsc *find_action(struct actdsc *, const char *);
+static struct argdsc *find_argument(struct argdsc *, const char *);
+static int route_changed(struct route_state *, struct routing_decision *);
+static void route_update(struct route_state *, struct routing_decision *);
+static void route_mirror(struct userdata *);
+static void decision_set_init(struct decision_set *);
+static void decision_set_clear(struct decision_set *);
+static void decision_set_free(struct decision_set *);
+static void decision_put(pa_hashmap *, const char *, int);
+static void decision_value_free(struct decision_value *);
+static void decision_set_serialize(struct decision_set *,
+                                   struct decision_bytes *);
+static void decision_bytes_add(struct decision_bytes *, const void *, size_t);
+static uint64_t fingerprint_add(uint64_t, const void *, size_t);
+static int apply_decisions(struct userdata *, struct decision_set *);
+static int apply_route(struct userdata *, struct routing_decision *, int);
+static void txn_done(struct userdata *, uint32_t, int);
+static void apply_cb(pa_mainloop_api *, pa_time_event *,
+                     const struct timeval *, void *);
 static int action_parser(DBusMessageIter *, struct argdsc *, void *, int);
-static int audio_route_parser(struct userdata *, DBusMessageIter *);
-static int volume_limit_parser(struct userdata *, DBusMessageIter *);
-static int audio_cork_parser(struct userdata *, DBusMessageIter *);
-static int audio_mute_parser(struct userdata *, DBusMessageIter *);
-static int context_parser(struct userdata *, DBusMessageIter *);
+static int audio_route_parser(struct userdata *, DBusMessageIter *,
+                              struct decision_set *);
+static int volume_limit_parser(struct userdata *, DBusMessageIter *,
+                               struct decision_set *);
+static int audio_cork_parser(struct userdata *, DBusMessageIter *,
+                             struct decision_set *);
+static int audio_mute_parser(struct userdata *, DBusMessageIter *,
+                             struct decision_set *);
+static int context_parser(struct userdata *, DBusMessageIter *,
+                          struct decision_set *);
 
 static DBusHandlerResult filter(DBusConnection *, DBusMessage *, void *);
 static void handle_admin_message(struct userdata *, DBusMessage *);
@@ -128,7 +222,8 @@ struct pa_policy_dbusif *pa_policy_dbusif_init(struct userdata *u,
                                                const char      *ifnam,
                                                const char      *mypath,
                                                const char      *pdpath,
-                                               const char      *pdnam)
+                                               const char      *pdnam,
+                                               const char      *coalesce)
 {
     pa_module               *m = u->module;
     struct pa_policy_dbusif *dbusif = NULL;
@@ -140,7 +235,19 @@ struct pa_policy_dbusif *pa_policy_dbusif_init(struct userdata *u,
     
     dbusif = pa_xnew0(struct pa_policy_dbusif, 1);
 
+    dbusif->mainloop = m->core->mainloop;
+
+    decision_set_init(&dbusif->pending);
+
     dbus_error_init(&error);
+
+    if (coalesce != NULL) {
+        if (!strcmp(coalesce, "on"))
+            dbusif->coalesce = true;
+        else if (strcmp(coalesce, "off"))
+            pa_log("invalid value '%s' for action coalescing", coalesce);
+    }
+
     dbusif->conn = pa_dbus_bus_get(m->core, DBUS_BUS_SYSTEM, &error);
 
     if (dbusif->conn == NULL || dbus_error_is_set(&error)) {
@@ -236,6 +343,7 @@ static void pa_policy_free_dbusif(struct pa_policy_dbusif *dbusif,
                                   struct userdata *u)
 {
     DBusConnection          *dbusconn;
+    int                      i;
 
     if (!dbusif)
         return;
@@ -248,6 +356,18 @@ static void pa_policy_free_dbusif(struct pa_policy_dbusif *dbusif,
         dbus_pending_call_unref(dbusif->pending_pdp_registration);
     }
 
+    if (dbusif->conn && dbusif->ntxn > 0 && u && u->dbusif == dbusif) {
+        /* every transaction gets a status; the queued ones are not applied */
+        pa_log_debug("%d transaction(s) dropped at unload", dbusif->ntxn);
+
+        for (i = 0;  i < dbusif->ntxn;  i++)
+            signal_status(u, dbusif->txns[i].txid, false);
+
+        dbus_connection_flush(pa_dbus_connection_get(dbusif->conn));
+    }
+
+    dbusif->ntxn = 0;
+
     if (dbusif->conn) {
         dbusconn = pa_dbus_connection_get(dbusif->conn);
 
@@ -268,6 +388,21 @@ static void pa_policy_free_dbusif(struct pa_policy_dbusif *dbusif,
     pa_xfree(dbusif->admrule);
     pa_xfree(dbusif->actrule);
     pa_xfree(dbusif->strrule);
+
+    if (dbusif->timer != NULL)
+        dbusif->mainloop->time_free(dbusif->timer);
+
+    decision_set_free(&dbusif->pending);
+    pa_xfree(dbusif->txns);
+    pa_xfree(dbusif->last.data);
+    pa_xfree(dbusif->current.data);
+
+    for (i = 0;  i < pa_policy_route_max;  i++) {
+        pa_xfree(dbusif->route[i].target);
+        pa_xfree(dbusif->route[i].mode);
+        pa_xfree(dbusif->route[i].hwid);
+    }
+
     pa_xfree(dbusif);
 }
 
@@ -509,13 +644,12 @@ static void handle_info_message(struct userdata *u, DBusMessage *msg)
 
 static void handle_action_message(struct userdata *u, DBusMessage *msg)
 {
-    static struct actdsc actions[] = {
-        { "com.nokia.policy.audio_route" , audio_route_parser  },
-        { "com.nokia.policy.volume_limit", volume_limit_parser },
-        { "com.nokia.policy.audio_cork"  , audio_cork_parser   },
-        { "com.nokia.policy.audio_mute"  , audio_mute_parser   },
-        { "com.nokia.policy.context"     , context_parser      },
-        {               NULL             , NULL                }
+    static struct actdsc actions[ACTION_MAX] = {
+        [ACTION(audio_route) ] = { audio_route_parser  },
+        [ACTION(volume_limit)] = { volume_limit_parser },
+        [ACTION(audio_cork)  ] = { audio_cork_parser   },
+        [ACTION(audio_mute)  ] = { audio_mute_parser   },
+        [ACTION(context)     ] = { context_parser      },
     };
 
     struct actdsc   *act;
@@ -575,22 +709,346 @@ static void handle_action_message(struct userdata *u, DBusMessage *msg)
                 continue;
             }
             
-            for (act = actions;   act->name != NULL;   act++) {
-                if (!strcmp(actname, act->name))
-                    break;
-            }
-                                    
-            if (act->parser != NULL)
-                success &= act->parser(u, &actit);
+            if ((act = find_action(actions, actname)) != NULL)
+                success &= act->parser(u, &actit, &u->dbusif->pending);
 
         } while (dbus_message_iter_next(&entit));
 
     } while (dbus_message_iter_next(&arrit));
 
-    pa_policy_context_variable_commit(u);
-
  send_signal:
-    signal_status(u, txid, success);
+    txn_done(u, txid, success);
+}
+
+/*
+ * Without coalescing the decisions of a transaction are applied right
+ * away. Otherwise they are merged into the pending set; a later decision
+ * for the same route, group or device supersedes the earlier one. The
+ * set is applied when no transaction came for COALESCE_WINDOW, but no
+ * transaction waits longer than COALESCE_LIMIT.
+ */
+static void txn_done(struct userdata *u, uint32_t txid, int success)
+{
+    struct pa_policy_dbusif *dbusif = u->dbusif;
+    struct txn_status       *txn;
+    pa_usec_t                now;
+    pa_usec_t                deadline;
+
+    if (!dbusif->coalesce) {
+        success &= apply_decisions(u, &dbusif->pending);
+        signal_status(u, txid, success);
+        return;
+    }
+
+    if (dbusif->ntxn >= dbusif->maxtxn) {
+        dbusif->maxtxn = dbusif->maxtxn ? dbusif->maxtxn * 2 : 4;
+        dbusif->txns   = pa_xrenew(struct txn_status, dbusif->txns,
+                                   dbusif->maxtxn);
+    }
+
+    now = pa_rtclock_now();
+
+    if (dbusif->ntxn == 0)
+        dbusif->first = now;
+
+    txn = dbusif->txns + dbusif->ntxn++;
+    txn->txid    = txid;
+    txn->success = success;
+
+    deadline = PA_MIN(now + COALESCE_WINDOW, dbusif->first + COALESCE_LIMIT);
+
+    if (dbusif->timer == NULL)
+        dbusif->timer = pa_core_rttime_new(u->core, deadline, apply_cb, u);
+    else
+        pa_core_rttime_restart(u->core, dbusif->timer, deadline);
+}
+
+static void apply_cb(pa_mainloop_api      *m,
+                     pa_time_event        *e,
+                     const struct timeval *t,
+                     void                 *userdata)
+{
+    struct userdata         *u = userdata;
+    struct pa_policy_dbusif *dbusif;
+    int                      success;
+    int                      i;
+
+    pa_assert(u);
+    pa_assert_se((dbusif = u->dbusif));
+
+    pa_log_debug("applying the decisions of %d transaction(s)", dbusif->ntxn);
+
+    success = apply_decisions(u, &dbusif->pending);
+
+    for (i = 0;  i < dbusif->ntxn;  i++) {
+        signal_status(u, dbusif->txns[i].txid,
+                      dbusif->txns[i].success && success);
+    }
+
+    dbusif->ntxn = 0;
+}
+
+static int apply_decisions(struct userdata *u, struct decision_set *set)
+{
+    struct pa_policy_dbusif *dbusif = u->dbusif;
+    struct routing_decision  decisions[MAX_ROUTING_DECISIONS];
+    struct decision_value   *d;
+    void                    *state;
+    struct decision_bytes    swap;
+    uint64_t                 fingerprint;
+    int                      num_decisions = 0;
+    int                      success = true;
+    int                      class;
+    int                      i;
+
+    /*
+     * The policy daemon resends the full state on every re-evaluation.
+     * If the parts kept in the module's own state are the same as the
+     * last successfully applied ones, skip the groups, streams and sinks
+     * altogether.
+     */
+    decision_set_serialize(set, &dbusif->current);
+    fingerprint = fingerprint_add(FINGERPRINT_INIT, dbusif->current.data,
+                                  dbusif->current.len);
+
+    /* a matching fingerprint is confirmed byte by byte */
+    if (dbusif->applied && fingerprint == dbusif->fingerprint &&
+        dbusif->current.len == dbusif->last.len &&
+        !memcmp(dbusif->current.data, dbusif->last.data, dbusif->last.len))
+    {
+        dbusif->unchanged++;
+
+        pa_log_debug("decisions are unchanged (%u times so far)",
+                     dbusif->unchanged);
+
+        /* only the counter; no need to bother the subscribers */
+        pa_proplist_setf(u->module->proplist, PROP_DECISIONS_UNCHANGED,
+                         "%u", dbusif->unchanged);
+    }
+    else {
+        for (class = 0;  class < pa_policy_route_max;  class++) {
+            if (set->route[class].target != NULL)
+                decisions[num_decisions++] = set->route[class];
+        }
+
+        if (num_decisions > 0 && !apply_route(u, decisions, num_decisions))
+            success = false;
+
+        PA_HASHMAP_FOREACH(d, set->limit, state) {
+            if (pa_policy_group_volume_limit(u, d->name,
+                                             (uint32_t)d->value) < 0)
+                success = false;
+        }
+
+        PA_HASHMAP_FOREACH(d, set->cork, state) {
+            if (pa_policy_group_cork(u, d->name, d->value) < 0)
+                success = false;
+        }
+
+        for (i = 0;  i < set->ncontext;  i++) {
+            pa_policy_context_variable_changed(u, set->context[i].variable,
+                                               set->context[i].value);
+        }
+
+        pa_policy_context_variable_commit(u);
+
+        dbusif->fingerprint = fingerprint;
+        dbusif->applied     = success;
+
+        swap            = dbusif->last;
+        dbusif->last    = dbusif->current;
+        dbusif->current = swap;
+    }
+
+    /*
+     * Source mutes are compared against the live source state, which
+     * others may have changed since; they are never skipped.
+     */
+    PA_HASHMAP_FOREACH(d, set->mute, state) {
+        if (pa_source_ext_set_mute(u, d->name, d->value) < 0)
+            success = false;
+    }
+
+    decision_set_clear(set);
+
+    return success;
+}
+
+static void decision_set_serialize(struct decision_set   *set,
+                                   struct decision_bytes *bytes)
+{
+    struct routing_decision *route;
+    struct decision_value   *d;
+    pa_hashmap              *maps[2];
+    void                    *state;
+    uint32_t                 count;
+    int                      class;
+    int                      i;
+
+    /* every section starts with its entry count, so no two sets collide */
+    bytes->len = 0;
+
+    for (count = 0, class = 0;  class < pa_policy_route_max;  class++)
+        count += (set->route[class].target != NULL);
+
+    decision_bytes_add(bytes, &count, sizeof(count));
+
+    for (class = 0;  class < pa_policy_route_max;  class++) {
+        route = set->route + class;
+
+        if (route->target != NULL) {
+            decision_bytes_add(bytes, &class, sizeof(class));
+            decision_bytes_add(bytes, route->target, strlen(route->target)+1);
+            decision_bytes_add(bytes, route->mode, strlen(route->mode)+1);
+            decision_bytes_add(bytes, route->hwid, strlen(route->hwid)+1);
+        }
+    }
+
+    /* the source mutes are left out; they are always applied */
+    maps[0] = set->limit;
+    maps[1] = set->cork;
+
+    for (i = 0;  i < 2;  i++) {
+        count = pa_hashmap_size(maps[i]);
+        decision_bytes_add(bytes, &count, sizeof(count));
+
+        PA_HASHMAP_FOREACH(d, maps[i], state) {
+            decision_bytes_add(bytes, d->name, strlen(d->name)+1);
+            decision_bytes_add(bytes, &d->value, sizeof(d->value));
+        }
+    }
+
+    count = set->ncontext;
+    decision_bytes_add(bytes, &count, sizeof(count));
+
+    for (i = 0;  i < set->ncontext;  i++) {
+        decision_bytes_add(bytes, set->context[i].variable,
+                           strlen(set->context[i].variable)+1);
+        decision_bytes_add(bytes, set->context[i].value,
+                           strlen(set->context[i].value)+1);
+    }
+}
+
+static void decision_bytes_add(struct decision_bytes *bytes,
+                               const void            *data,
+                               size_t                 len)
+{
+    if (bytes->len + len > bytes->size) {
+        bytes->size = bytes->size ? bytes->size * 2 : 256;
+
+        if (bytes->size < bytes->len + len)
+            bytes->size = bytes->len + len;
+
+        bytes->data = pa_xrealloc(bytes->data, bytes->size);
+    }
+
+    memcpy(bytes->data + bytes->len, data, len);
+    bytes->len += len;
+}
+
+static uint64_t fingerprint_add(uint64_t fp, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    size_t         i;
+
+    for (i = 0;  i < len;  i++) {
+        fp ^= p[i];
+        fp *= FINGERPRINT_PRIME;
+    }
+
+    return fp;
+}
+
+static void decision_set_init(struct decision_set *set)
+{
+    memset(set, 0, sizeof(*set));
+
+    set->limit = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                     pa_idxset_string_compare_func, NULL,
+                                     (pa_free_cb_t) decision_value_free);
+    set->cork  = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                     pa_idxset_string_compare_func, NULL,
+                                     (pa_free_cb_t) decision_value_free);
+    set->mute  = pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                     pa_idxset_string_compare_func, NULL,
+                                     (pa_free_cb_t) decision_value_free);
+}
+
+static void decision_set_clear(struct decision_set *set)
+{
+    struct routing_decision *route;
+    int                      class;
+    int                      i;
+
+    for (class = 0;  class < pa_policy_route_max;  class++) {
+        route = set->route + class;
+
+        pa_xfree(route->target);
+        pa_xfree(route->mode);
+        pa_xfree(route->hwid);
+
+        memset(route, 0, sizeof(*route));
+    }
+
+    pa_hashmap_remove_all(set->limit);
+    pa_hashmap_remove_all(set->cork);
+    pa_hashmap_remove_all(set->mute);
+
+    for (i = 0;  i < set->ncontext;  i++) {
+        pa_xfree(set->context[i].variable);
+        pa_xfree(set->context[i].value);
+    }
+
+    set->ncontext = 0;
+}
+
+static void decision_set_free(struct decision_set *set)
+{
+    if (set->limit != NULL) {
+        decision_set_clear(set);
+
+        pa_hashmap_free(set->limit);
+        pa_hashmap_free(set->cork);
+        pa_hashmap_free(set->mute);
+
+        pa_xfree(set->context);
+    }
+}
+
+static void decision_put(pa_hashmap *map, const char *name, int value)
+{
+    struct decision_value *d;
+
+    if ((d = pa_hashmap_get(map, name)) == NULL) {
+        d = pa_xnew0(struct decision_value, 1);
+        d->name = pa_xstrdup(name);
+        pa_hashmap_put(map, d->name, d);
+    }
+
+    d->value = value;
+}
+
+static void decision_value_free(struct decision_value *d)
+{
+    if (d != NULL) {
+        pa_xfree(d->name);
+        pa_xfree(d);
+    }
+}
+
+/* the name picks the descriptor; a table lacks the ones it has no use for */
+static struct actdsc *find_action(struct actdsc *actions, const char *name)
+{
+    struct actdsc *act = &actions[pa_policy_action_id(name)];
+
+    return act->parser ? act : NULL;
+}
+
+static struct argdsc *find_argument(struct argdsc *descs, const char *name)
+{
+    struct argdsc *desc = &descs[pa_policy_argument_id(name)];
+
+    return desc->type != DBUS_TYPE_INVALID ? desc : NULL;
 }
 
 static int action_parser(DBusMessageIter *actit, struct argdsc *descs,
@@ -626,22 +1084,19 @@ static int action_parser(DBusMessageIter *actit, struct argdsc *descs,
 
         dbus_message_iter_recurse(&argit, &valit);
 
-        for (desc = descs;  desc->name != NULL;  desc++) {
-            if (!strcmp(argname, desc->name)) {
-                if (desc->offs + (int)sizeof(char *) > len) {
-                    pa_log("%s(): desc offset %d is out of range %d",
-                           __FUNCTION__, desc->offs, len);
+        if ((desc = find_argument(descs, argname)) != NULL) {
+            if (desc->offs + (int)sizeof(char *) > len) {
+                pa_log("%s(): desc offset %d is out of range %d",
+                       __FUNCTION__, desc->offs, len);
+                return false;
+            }
+            else {
+                if (dbus_message_iter_get_arg_type(&valit) != desc->type)
                     return false;
-                }
-                else {
-                    if (dbus_message_iter_get_arg_type(&valit) != desc->type)
-                        return false;
 
-                    argval = (char *)args + desc->offs;
+                argval = (char *)args + desc->offs;
 
-                    dbus_message_iter_get_basic(&valit, argval);
-                }
-                break;
+                dbus_message_iter_get_basic(&valit, argval);
             }
         }
 
@@ -650,25 +1105,21 @@ static int action_parser(DBusMessageIter *actit, struct argdsc *descs,
     return true;
 }
 
-static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
+static int audio_route_parser(struct userdata *u, DBusMessageIter *actit,
+                              struct decision_set *set)
 {
-    static struct argdsc descs[] = {
-        {"type"  , STRUCT_OFFSET(struct argrt, type)  , DBUS_TYPE_STRING },
-        {"device", STRUCT_OFFSET(struct argrt, device), DBUS_TYPE_STRING },
-        {"mode"  , STRUCT_OFFSET(struct argrt, mode),   DBUS_TYPE_STRING },
-        {"hwid"  , STRUCT_OFFSET(struct argrt, hwid),   DBUS_TYPE_STRING },
-        {  NULL  ,            0                       , DBUS_TYPE_INVALID}
+    static struct argdsc descs[ARG_MAX] = {
+        [ARG(type)  ] = { STRUCT_OFFSET(struct argrt, type)  , DBUS_TYPE_STRING },
+        [ARG(device)] = { STRUCT_OFFSET(struct argrt, device), DBUS_TYPE_STRING },
+        [ARG(mode)  ] = { STRUCT_OFFSET(struct argrt, mode)  , DBUS_TYPE_STRING },
+        [ARG(hwid)  ] = { STRUCT_OFFSET(struct argrt, hwid)  , DBUS_TYPE_STRING },
     };
 
     struct argrt args;
-    pa_proplist *p = NULL;
     struct routing_decision decisions[MAX_ROUTING_DECISIONS];
+    struct routing_decision *route;
     int num_decisions = 0;
-    int num_decisions_done = 0;
     int i = 0;
-    int num_moving = 0;
-    bool result = true;
-    bool route_changed = false;
 
     /* Parse message. It's safe to bail out here, because we're not moving any streams yet. */
     do {
@@ -701,53 +1152,77 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
                                                           decisions[i].mode,
                                                           decisions[i].hwid);
 
-        p = u->module->proplist;
+    } while (dbus_message_iter_next(actit));
 
-        if (decisions[i].class == pa_policy_route_to_sink) {
-            if (!pa_streq(pa_strempty(pa_proplist_gets(p, PROP_ROUTE_SINK_TARGET)), decisions[i].target) ||
-                !pa_streq(pa_strempty(pa_proplist_gets(p, PROP_ROUTE_SINK_MODE  )), decisions[i].mode)   ||
-                !pa_streq(pa_strempty(pa_proplist_gets(p, PROP_ROUTE_SINK_HWID  )), decisions[i].hwid)) {
+    /* Record the decisions; they are applied as one route transaction. */
+    for (i = 0; i < num_decisions; i++) {
+        route = set->route + decisions[i].class;
 
-                route_changed = true;
-                pa_log_debug("Sink route has changed");
-            }
-        } else {
-            if (!pa_streq(pa_strempty(pa_proplist_gets(p, PROP_ROUTE_SOURCE_TARGET)), decisions[i].target) ||
-                !pa_streq(pa_strempty(pa_proplist_gets(p, PROP_ROUTE_SOURCE_MODE  )), decisions[i].mode)   ||
-                !pa_streq(pa_strempty(pa_proplist_gets(p, PROP_ROUTE_SOURCE_HWID  )), decisions[i].hwid)) {
+        pa_xfree(route->target);
+        pa_xfree(route->mode);
+        pa_xfree(route->hwid);
 
-                route_changed = true;
-                pa_log_debug("Source route has changed");
-            }
-        }
+        route->class  = decisions[i].class;
+        route->target = pa_xstrdup(decisions[i].target);
+        route->mode   = pa_xstrdup(decisions[i].mode);
+        route->hwid   = pa_xstrdup(decisions[i].hwid);
+    }
 
-    } while (dbus_message_iter_next(actit));
+    return true;
+}
 
-    if (!route_changed) {
+static int apply_route(struct userdata         *u,
+                       struct routing_decision *decisions,
+                       int                      num_decisions)
+{
+    struct route_state *route = u->dbusif->route;
+    pa_idxset *cards;
+    int num_decisions_done = 0;
+    int i = 0;
+    int num_moving = 0;
+    bool result = true;
+    bool changed = false;
+
+    for (i = 0; i < num_decisions; i++) {
+        if (route_changed(route + decisions[i].class, decisions + i)) {
+            changed = true;
+            pa_log_debug("%s route has changed",
+                         decisions[i].class == pa_policy_route_to_sink ?
+                         "Sink" : "Source");
+        }
+    }
+
+    if (!changed) {
         pa_log_debug("New audio route is identical to the current one. No need to move streams.");
         return true;
     }
 
-    /* Detach groups. */
-    num_moving = pa_policy_group_start_move_all(u);
-    pa_log_debug("Policy groups moving: %d", num_moving);
+    /*
+     * Plan the move: find the cards that are about to change profile,
+     * then detach only the groups that change device or sit on one of
+     * those cards. The rest keep playing.
+     */
+    cards = pa_idxset_new(pa_idxset_trivial_hash_func,
+                          pa_idxset_trivial_compare_func);
+
+    for (i = 0; i < num_decisions; i++)
+        pa_card_ext_profile_pending(u, decisions[i].target, cards);
 
-    /* Set profiles and ports while the groups are detached. */
     for (i = 0; i < num_decisions; i++) {
-        p = pa_proplist_new();
+        num_moving += pa_policy_group_start_move(u, decisions[i].class,
+                                                 decisions[i].target, cards);
+    }
 
-        if (decisions[i].class == pa_policy_route_to_sink) {
-            pa_proplist_sets(p, PROP_ROUTE_SINK_TARGET, decisions[i].target);
-            pa_proplist_sets(p, PROP_ROUTE_SINK_MODE,   decisions[i].mode);
-            pa_proplist_sets(p, PROP_ROUTE_SINK_HWID,   decisions[i].hwid);
-        } else {
-            pa_proplist_sets(p, PROP_ROUTE_SOURCE_TARGET, decisions[i].target);
-            pa_proplist_sets(p, PROP_ROUTE_SOURCE_MODE,   decisions[i].mode);
-            pa_proplist_sets(p, PROP_ROUTE_SOURCE_HWID,   decisions[i].hwid);
-        }
+    pa_idxset_free(cards, NULL);
 
-        pa_module_update_proplist(u->module, PA_UPDATE_REPLACE, p);
-        pa_proplist_free(p);
+    pa_log_debug("Policy groups moving: %d", num_moving);
+
+    /* Send the proplist notifications once per object at the end. */
+    pa_policy_context_hold_notifications(u);
+
+    /* Set profiles and ports while the groups are detached. */
+    for (i = 0; i < num_decisions; i++) {
+        route_update(route + decisions[i].class, decisions + i);
 
         if (pa_card_ext_set_profile(u, decisions[i].target) < 0 ||
               (decisions[i].class == pa_policy_route_to_sink &&
@@ -784,8 +1259,7 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
                          num_moved,
                          decisions[i].class == pa_policy_route_to_sink ? "sink" : "source",
                          decisions[i].target);
-            if (num_moving == num_moved)
-                num_decisions_done++;
+            num_decisions_done++;
         }
     }
 
@@ -793,20 +1267,70 @@ static int audio_route_parser(struct userdata *u, DBusMessageIter *actit)
     if (num_decisions != num_decisions_done) {
         pa_log_error("Got %d routing decisions. %d decisions were incomplete.",
                      num_decisions, num_decisions - num_decisions_done);
-
-        pa_policy_group_assert_moving(u);
         result = false;
     }
 
+    if (num_moving > 0 && pa_policy_group_assert_moving(u) > 0)
+        result = false;
+
+    pa_policy_context_flush_notifications(u);
+
+    /* Mirror the new route to the module proplist in one go. */
+    route_mirror(u);
+
     return result;
 }
 
-static int volume_limit_parser(struct userdata *u, DBusMessageIter *actit)
+static int route_changed(struct route_state      *rt,
+                         struct routing_decision *d)
 {
-    static struct argdsc descs[] = {
-        {"group", STRUCT_OFFSET(struct argvol, group), DBUS_TYPE_STRING },
-        {"limit", STRUCT_OFFSET(struct argvol, limit), DBUS_TYPE_INT32  },
-        {  NULL ,            0                       , DBUS_TYPE_INVALID}
+    return !pa_streq(pa_strempty(rt->target), d->target) ||
+           !pa_streq(pa_strempty(rt->mode)  , d->mode)   ||
+           !pa_streq(pa_strempty(rt->hwid)  , d->hwid);
+}
+
+static void route_update(struct route_state      *rt,
+                         struct routing_decision *d)
+{
+    pa_xfree(rt->target);
+    pa_xfree(rt->mode);
+    pa_xfree(rt->hwid);
+
+    rt->target = pa_xstrdup(d->target);
+    rt->mode   = pa_xstrdup(d->mode);
+    rt->hwid   = pa_xstrdup(d->hwid);
+}
+
+static void route_mirror(struct userdata *u)
+{
+    struct route_state *sink = u->dbusif->route + pa_policy_route_to_sink;
+    struct route_state *src  = u->dbusif->route + pa_policy_route_to_source;
+    pa_proplist        *p;
+
+    p = pa_proplist_new();
+
+    if (sink->target != NULL) {
+        pa_proplist_sets(p, PROP_ROUTE_SINK_TARGET, sink->target);
+        pa_proplist_sets(p, PROP_ROUTE_SINK_MODE,   sink->mode);
+        pa_proplist_sets(p, PROP_ROUTE_SINK_HWID,   sink->hwid);
+    }
+
+    if (src->target != NULL) {
+        pa_proplist_sets(p, PROP_ROUTE_SOURCE_TARGET, src->target);
+        pa_proplist_sets(p, PROP_ROUTE_SOURCE_MODE,   src->mode);
+        pa_proplist_sets(p, PROP_ROUTE_SOURCE_HWID,   src->hwid);
+    }
+
+    pa_module_update_proplist(u->module, PA_UPDATE_REPLACE, p);
+    pa_proplist_free(p);
+}
+
+static int volume_limit_parser(struct userdata *u, DBusMessageIter *actit,
+                               struct decision_set *set)
+{
+    static struct argdsc descs[ARG_MAX] = {
+        [ARG(group)] = { STRUCT_OFFSET(struct argvol, group), DBUS_TYPE_STRING },
+        [ARG(limit)] = { STRUCT_OFFSET(struct argvol, limit), DBUS_TYPE_INT32  },
     };
 
     struct argvol  args;
@@ -825,21 +1349,19 @@ static int volume_limit_parser(struct userdata *u, DBusMessageIter *actit)
 
         pa_log_debug("volume limit (%s|%d)", args.group, args.limit); 
 
-        pa_policy_group_volume_limit(u, args.group, (uint32_t)args.limit);
+        decision_put(set->limit, args.group, args.limit);
 
     } while (dbus_message_iter_next(actit));
 
-    pa_sink_ext_set_volumes(u);
-
     return success;
 }
 
-static int audio_cork_parser(struct userdata *u, DBusMessageIter *actit)
+static int audio_cork_parser(struct userdata *u, DBusMessageIter *actit,
+                             struct decision_set *set)
 {
-    static struct argdsc descs[] = {
-        {"group", STRUCT_OFFSET(struct argcork, group), DBUS_TYPE_STRING },
-        {"cork" , STRUCT_OFFSET(struct argcork, cork) , DBUS_TYPE_STRING },
-        { NULL  ,            0                        , DBUS_TYPE_INVALID}
+    static struct argdsc descs[ARG_MAX] = {
+        [ARG(group)] = { STRUCT_OFFSET(struct argcork, group), DBUS_TYPE_STRING },
+        [ARG(cork) ] = { STRUCT_OFFSET(struct argcork, cork) , DBUS_TYPE_STRING },
     };
     
     struct argcork  args;
@@ -863,19 +1385,19 @@ static int audio_cork_parser(struct userdata *u, DBusMessageIter *actit)
             return false;
         
         pa_log_debug("cork stream (%s|%d)", grp, val);
-        pa_policy_group_cork(u, grp, val);
+        decision_put(set->cork, grp, val);
 
     } while (dbus_message_iter_next(actit));
     
     return true;
 }
 
-static int audio_mute_parser(struct userdata *u, DBusMessageIter *actit)
+static int audio_mute_parser(struct userdata *u, DBusMessageIter *actit,
+                             struct decision_set *set)
 {
-    static struct argdsc descs[] = {
-        {"device", STRUCT_OFFSET(struct argmute, device), DBUS_TYPE_STRING },
-        {"mute"  , STRUCT_OFFSET(struct argmute, mute)  , DBUS_TYPE_STRING },
-        { NULL   ,            0                         , DBUS_TYPE_INVALID}
+    static struct argdsc descs[ARG_MAX] = {
+        [ARG(device)] = { STRUCT_OFFSET(struct argmute, device), DBUS_TYPE_STRING },
+        [ARG(mute)  ] = { STRUCT_OFFSET(struct argmute, mute)  , DBUS_TYPE_STRING },
     };
     
     struct argmute  args;
@@ -899,22 +1421,23 @@ static int audio_mute_parser(struct userdata *u, DBusMessageIter *actit)
             return false;
         
         pa_log_debug("mute device (%s|%d)", device, val);
-        pa_source_ext_set_mute(u, device, val);
+        decision_put(set->mute, device, val);
 
     } while (dbus_message_iter_next(actit));
     
     return true;
 }
 
-static int context_parser(struct userdata *u, DBusMessageIter *actit)
+static int context_parser(struct userdata *u, DBusMessageIter *actit,
+                          struct decision_set *set)
 {
-    static struct argdsc descs[] = {
-        {"variable", STRUCT_OFFSET(struct argctx,variable), DBUS_TYPE_STRING },
-        {"value"   , STRUCT_OFFSET(struct argctx,value)   , DBUS_TYPE_STRING },
-        {  NULL    ,            0                         , DBUS_TYPE_INVALID}
+    static struct argdsc descs[ARG_MAX] = {
+        [ARG(variable)] = { STRUCT_OFFSET(struct argctx,variable), DBUS_TYPE_STRING },
+        [ARG(value)   ] = { STRUCT_OFFSET(struct argctx,value)   , DBUS_TYPE_STRING },
     };
     
-    struct argctx   args;
+    struct argctx          args;
+    struct context_change *change;
     
     do {
         if (!action_parser(actit, descs, &args, sizeof(args)))
@@ -925,7 +1448,15 @@ static int context_parser(struct userdata *u, DBusMessageIter *actit)
 
         pa_log_debug("context (%s|%s)", args.variable, args.value);
 
-        pa_policy_context_variable_changed(u, args.variable, args.value);
+        if (set->ncontext >= set->maxcontext) {
+            set->maxcontext = set->maxcontext ? set->maxcontext * 2 : 16;
+            set->context    = pa_xrenew(struct context_change, set->context,
+                                        set->maxcontext);
+        }
+
+        change = set->context + set->ncontext++;
+        change->variable = pa_xstrdup(args.variable);
+        change->value    = pa_xstrdup(args.value);
 
     } while (dbus_message_iter_next(actit));
     
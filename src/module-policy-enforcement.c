@@ -60,6 +60,7 @@ PA_MODULE_USAGE(
     "dbus_policyd_name=<policy daemon's name> "
     "null_sink_name=<name of the null sink> "
     "othermedia_preemption=<on|off> "
+    "coalesce_actions=<on|off; on delays applying by 5-20 ms> "
     "configdir=<configuration directory>"
 );
 
@@ -71,6 +72,7 @@ static const char* const valid_modargs[] = {
     "dbus_policyd_name",
     "null_sink_name",
     "othermedia_preemption",
+    "coalesce_actions",
     "configdir",
     NULL
 };
@@ -86,6 +88,7 @@ int pa__init(pa_module *m) {
     const char      *pdnam;
     const char      *nsnam;
     const char      *preempt;
+    const char      *coalesce;
     const char      *cfgdir;
     
     pa_assert(m);
@@ -102,6 +105,7 @@ int pa__init(pa_module *m) {
     pdnam   = pa_modargs_get_value(ma, "dbus_policyd_name", NULL);
     nsnam   = pa_modargs_get_value(ma, "null_sink_name", NULL);
     preempt = pa_modargs_get_value(ma, "othermedia_preemption", NULL);
+    coalesce = pa_modargs_get_value(ma, "coalesce_actions", NULL);
     cfgdir  = pa_modargs_get_value(ma, "configdir", NULL);
 
     
@@ -111,7 +115,10 @@ int pa__init(pa_module *m) {
     u->module   = m;
     u->nullsink = pa_sink_ext_init_null_sink(nsnam);
     u->hsnk     = pa_index_hash_init(8);
+    u->hsrc     = pa_index_hash_init(8);
+    u->hcrd     = pa_index_hash_init(8);
     u->hsi      = pa_index_hash_init(10);
+    u->hso      = pa_index_hash_init(8);
     u->scl      = pa_client_ext_subscription(u);
     u->ssnk     = pa_sink_ext_subscription(u);
     u->ssrc     = pa_source_ext_subscription(u);
@@ -122,7 +129,8 @@ int pa__init(pa_module *m) {
     u->groups   = pa_policy_groupset_new(u);
     u->classify = pa_classify_new(u);
     u->context  = pa_policy_context_new(u);
-    u->dbusif   = pa_policy_dbusif_init(u, ifnam, mypath, pdpath, pdnam);
+    u->dbusif   = pa_policy_dbusif_init(u, ifnam, mypath, pdpath, pdnam,
+                                        coalesce);
     u->shared   = pa_shared_data_get(u->core);
 
     if (u->scl == NULL      || u->ssnk == NULL     || u->ssrc == NULL ||
@@ -189,7 +197,10 @@ void pa__done(pa_module *m) {
     pa_classify_free(u->classify);
     pa_policy_context_free(u->context);
     pa_index_hash_free(u->hsnk);
+    pa_index_hash_free(u->hsrc);
+    pa_index_hash_free(u->hcrd);
     pa_index_hash_free(u->hsi);
+    pa_index_hash_free(u->hso);
     pa_sink_ext_null_sink_free(u->nullsink);
     pa_shared_data_unref(u->shared);
 
@@ -0,0 +1,368 @@
+/*
+ * Registers and unregisters 1k streams against a context-heavy set of
+ * context rules, once by walking every variable, rule and action the
+ * way registration used to and once through the object index. Both have
+ * to bind the same streams to the same objects.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "context.h"
+
+#define NVARIABLE   100     /* context variables */
+#define NRULE       4       /* value rules per variable */
+#define NACTION     3       /* actions per rule */
+#define NOBJECT     (NVARIABLE * NRULE * NACTION)
+#define NNAME       400     /* distinct stream names */
+#define NSTREAM     1000    /* stream creations */
+#define ROUNDS      20
+
+struct object_visit {
+    enum pa_policy_object_type  type;
+    const char                 *name;
+    void                       *ptr;
+    unsigned long               index;
+};
+
+static int    equals(const char *, union pa_classify_arg *);
+static int    startswith(const char *, union pa_classify_arg *);
+static struct pa_policy_context_variable
+             *setup_rules(struct pa_policy_object **, char **);
+static void   free_rules(struct pa_policy_context_variable *);
+static void   walk_rules(struct pa_policy_context_variable *,
+                         pa_policy_object_visit_t, void *);
+static void   register_object(struct pa_policy_object *, int, void *);
+static void   unregister_object(struct pa_policy_object *, int, void *);
+static void   reset_objects(struct pa_policy_object **);
+static double now(void);
+
+
+int main(int argc, char **argv)
+{
+    static struct pa_policy_object *objects[NOBJECT];
+    static char                    *names[NOBJECT];
+    static char                     streams[NSTREAM][32];
+    static void                    *bound[NOBJECT];
+
+    struct pa_policy_context_variable *variables;
+    struct pa_policy_object_index   idx;
+    struct object_visit             visit;
+    enum pa_policy_object_type      type = pa_policy_object_sink_input;
+    int                             failed = 0;
+    int                             round;
+    int                             i, j;
+    double                          start;
+    double                          t_reg[2]   = { 0.0, 0.0 };
+    double                          t_unreg[2] = { 0.0, 0.0 };
+
+    (void)argc;
+    (void)argv;
+
+    srand(1);
+
+    variables = setup_rules(objects, names);
+
+    memset(&idx, 0, sizeof(idx));
+
+    for (i = 0;  i < NOBJECT;  i++) {
+        pa_policy_object_index_add(&idx, objects[i]->type,
+                       objects[i]->match.method == equals ? names[i] : NULL,
+                       objects[i], i + 1);
+    }
+
+    for (i = 0;  i < NSTREAM;  i++)
+        snprintf(streams[i], sizeof(streams[i]), "stream-%03d", rand() % NNAME);
+
+    for (round = 0;  round < ROUNDS;  round++) {
+        /* every action of every rule of every variable */
+        start = now();
+        for (i = 0;  i < NSTREAM;  i++) {
+            visit.type = type;
+            visit.name = streams[i];
+            visit.ptr  = streams[i];
+
+            walk_rules(variables, register_object, &visit);
+        }
+        t_reg[0] += now() - start;
+
+        for (j = 0;  j < NOBJECT;  j++)
+            bound[j] = objects[j]->ptr;
+
+        start = now();
+        for (i = 0;  i < NSTREAM;  i++) {
+            visit.ptr = streams[i];
+
+            walk_rules(variables, unregister_object, &visit);
+        }
+        t_unreg[0] += now() - start;
+
+        reset_objects(objects);
+
+        /* through the index */
+        start = now();
+        for (i = 0;  i < NSTREAM;  i++) {
+            visit.type = type;
+            visit.name = streams[i];
+            visit.ptr  = streams[i];
+
+            pa_policy_object_index_visit_name(&idx, type, streams[i],
+                                              register_object, &visit);
+        }
+        t_reg[1] += now() - start;
+
+        for (j = 0;  j < NOBJECT;  j++) {
+            if (bound[j] != objects[j]->ptr) {
+                printf("object %d: bound to %s instead of %s\n", j,
+                       objects[j]->ptr ? (char *)objects[j]->ptr : "<none>",
+                       bound[j] ? (char *)bound[j] : "<none>");
+                failed++;
+            }
+        }
+
+        start = now();
+        for (i = 0;  i < NSTREAM;  i++) {
+            visit.ptr = streams[i];
+
+            pa_policy_object_index_visit_all(&idx, type,
+                                             unregister_object, &visit);
+        }
+        t_unreg[1] += now() - start;
+
+        for (j = 0;  j < NOBJECT;  j++) {
+            if (objects[j]->ptr != NULL) {
+                printf("object %d: still bound after unregistering\n", j);
+                failed++;
+            }
+        }
+
+        reset_objects(objects);
+
+        if (failed)
+            break;
+    }
+
+    printf("%d objects (%d variables x %d rules x %d actions), "
+           "%d stream creations\n", NOBJECT, NVARIABLE, NRULE, NACTION,
+           NSTREAM);
+    printf("  every object: %8.1f us register, %8.1f us unregister\n",
+           t_reg[0] * 1e6 / ROUNDS, t_unreg[0] * 1e6 / ROUNDS);
+    printf("  object index: %8.1f us register, %8.1f us unregister\n",
+           t_reg[1] * 1e6 / ROUNDS, t_unreg[1] * 1e6 / ROUNDS);
+
+    pa_policy_object_index_free(&idx);
+    free_rules(variables);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int equals(const char *string, union pa_classify_arg *arg)
+{
+    return string && !strcmp(string, arg->string);
+}
+
+static int startswith(const char *string, union pa_classify_arg *arg)
+{
+    return string && !strncmp(string, arg->string, strlen(arg->string));
+}
+
+/*
+ * Most actions name one stream, sink or card with equals:, a few take
+ * every stream with a common prefix. Variables, rules and actions are
+ * linked lists, as the config parser builds them.
+ */
+static struct pa_policy_context_variable
+*setup_rules(struct pa_policy_object **objects, char **names)
+{
+    static const enum pa_policy_object_type types[] = {
+        pa_policy_object_sink,
+        pa_policy_object_source,
+        pa_policy_object_card,
+        pa_policy_object_module
+    };
+
+    struct pa_policy_context_variable  *variables = NULL;
+    struct pa_policy_context_variable **vlink = &variables;
+    struct pa_policy_context_variable  *var;
+    struct pa_policy_context_rule     **rlink;
+    struct pa_policy_context_rule      *rule;
+    union pa_policy_context_action    **alink;
+    union pa_policy_context_action     *actn;
+    struct pa_policy_object            *object;
+    char                                name[32];
+    int                                 v, r, a;
+    int                                 n = 0;
+    int                                 dice;
+
+    for (v = 0;  v < NVARIABLE;  v++) {
+        var = calloc(1, sizeof(*var));
+        *vlink = var;
+        vlink = &var->next;
+        rlink = &var->rules;
+
+        for (r = 0;  r < NRULE;  r++) {
+            rule = calloc(1, sizeof(*rule));
+            *rlink = rule;
+            rlink = &rule->next;
+            alink = &rule->actions;
+
+            for (a = 0;  a < NACTION;  a++) {
+                actn = calloc(1, sizeof(*actn));
+                *alink = actn;
+                alink = &actn->any.next;
+
+                actn->any.type   = pa_policy_set_property;
+                actn->any.lineno = n + 1;
+                object = &actn->setprop.object;
+
+                dice = rand() % 100;
+
+                if (dice < 50) {
+                    object->type = pa_policy_object_sink_input;
+                    snprintf(name, sizeof(name), "stream-%03d",
+                             rand() % NNAME);
+                    object->match.method = equals;
+                }
+                else if (dice < 55) {
+                    object->type = pa_policy_object_sink_input;
+                    snprintf(name, sizeof(name), "stream-%d", rand() % 10);
+                    object->match.method = startswith;
+                }
+                else {
+                    object->type = types[rand() % 4];
+                    snprintf(name, sizeof(name), "device-%03d",
+                             rand() % NNAME);
+                    object->match.method = equals;
+                }
+
+                names[n] = strdup(name);
+                object->match.arg.string = names[n];
+                object->ptr   = NULL;
+                object->index = PA_IDXSET_INVALID;
+
+                objects[n++] = object;
+            }
+        }
+    }
+
+    return variables;
+}
+
+static void free_rules(struct pa_policy_context_variable *variables)
+{
+    struct pa_policy_context_variable *var;
+    struct pa_policy_context_rule     *rule;
+    union pa_policy_context_action    *actn;
+
+    while ((var = variables) != NULL) {
+        variables = var->next;
+
+        while ((rule = var->rules) != NULL) {
+            var->rules = rule->next;
+
+            while ((actn = rule->actions) != NULL) {
+                rule->actions = actn->any.next;
+                free((char *)actn->setprop.object.match.arg.string);
+                free(actn);
+            }
+
+            free(rule);
+        }
+
+        free(var);
+    }
+}
+
+/* the walk registration and unregistration did before the index */
+static void walk_rules(struct pa_policy_context_variable *variables,
+                       pa_policy_object_visit_t           visit,
+                       void                              *userdata)
+{
+    struct pa_policy_context_variable *var;
+    struct pa_policy_context_rule     *rule;
+    union pa_policy_context_action    *actn;
+
+    for (var = variables;  var != NULL;  var = var->next) {
+        for (rule = var->rules;  rule != NULL;  rule = rule->next) {
+            for (actn = rule->actions;  actn != NULL;  actn = actn->any.next) {
+                switch (actn->any.type) {
+
+                case pa_policy_set_property:
+                    visit(&actn->setprop.object, actn->any.lineno, userdata);
+                    break;
+
+                case pa_policy_delete_property:
+                    visit(&actn->delprop.object, actn->any.lineno, userdata);
+                    break;
+
+                default:
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/* what context.c does with a candidate, without the logging */
+static void register_object(struct pa_policy_object *object, int lineno,
+                            void *userdata)
+{
+    struct object_visit *visit = userdata;
+
+    (void)lineno;
+
+    if (object->type == visit->type &&
+        object->match.method(visit->name, &object->match.arg) &&
+        object->ptr == NULL)
+    {
+        object->ptr   = visit->ptr;
+        object->index = 0;
+    }
+}
+
+static void unregister_object(struct pa_policy_object *object, int lineno,
+                              void *userdata)
+{
+    struct object_visit *visit = userdata;
+
+    (void)lineno;
+
+    if (visit->ptr == object->ptr) {
+        object->ptr   = NULL;
+        object->index = PA_IDXSET_INVALID;
+    }
+}
+
+static void reset_objects(struct pa_policy_object **objects)
+{
+    int i;
+
+    for (i = 0;  i < NOBJECT;  i++) {
+        objects[i]->ptr   = NULL;
+        objects[i]->index = PA_IDXSET_INVALID;
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,208 @@
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/macro.h>
+
+#include "object-index.h"
+
+
+static void bucket_append(struct pa_policy_object_bucket *,
+                          struct pa_policy_object *, int);
+static void bucket_visit(struct pa_policy_object_bucket *,
+                         pa_policy_object_visit_t, void *);
+static void bucket_clear(struct pa_policy_object_bucket *);
+static void bucket_free(struct pa_policy_object_bucket *);
+static void list_append(struct pa_policy_object_list *,
+                        struct pa_policy_object *, int);
+
+
+/*
+ * Objects with an equals: name go to the bucket of the name, all the
+ * others (startswith, matches, true) to the bucket of their type.
+ * Either way the order of definition is kept. Every object is also
+ * put in the array of its type, which is cheaper to walk than the
+ * buckets when all of them are visited.
+ */
+void pa_policy_object_index_add(struct pa_policy_object_index *idx,
+                                enum pa_policy_object_type     type,
+                                const char                    *equals,
+                                struct pa_policy_object       *object,
+                                int                            lineno)
+{
+    struct pa_policy_object_bucket *bucket;
+
+    pa_assert(idx);
+    pa_assert(object);
+
+    if (type <= pa_policy_object_min || type >= pa_policy_object_max)
+        return;
+
+    if (equals == NULL)
+        bucket = &idx->rest[type];
+    else {
+        if (idx->equals[type] == NULL) {
+            idx->equals[type] =
+                pa_hashmap_new_full(pa_idxset_string_hash_func,
+                                    pa_idxset_string_compare_func, NULL,
+                                    (pa_free_cb_t) bucket_free);
+        }
+
+        if ((bucket = pa_hashmap_get(idx->equals[type], equals)) == NULL) {
+            bucket = pa_xnew0(struct pa_policy_object_bucket, 1);
+            bucket->key = pa_xstrdup(equals);
+            pa_hashmap_put(idx->equals[type], bucket->key, bucket);
+        }
+    }
+
+    bucket_append(bucket, object, lineno);
+    list_append(&idx->all[type], object, lineno);
+}
+
+void pa_policy_object_index_free(struct pa_policy_object_index *idx)
+{
+    int type;
+
+    pa_assert(idx);
+
+    for (type = 0;  type < pa_policy_object_max;  type++) {
+        if (idx->equals[type] != NULL) {
+            pa_hashmap_free(idx->equals[type]);
+            idx->equals[type] = NULL;
+        }
+
+        bucket_clear(&idx->rest[type]);
+
+        pa_xfree(idx->all[type].refs);
+        memset(&idx->all[type], 0, sizeof(idx->all[type]));
+    }
+}
+
+/*
+ * Visits the objects of the type that can match the name: the ones
+ * defined with equals: the name, then the ones not using equals:.
+ */
+void pa_policy_object_index_visit_name(struct pa_policy_object_index *idx,
+                                       enum pa_policy_object_type     type,
+                                       const char                    *name,
+                                       pa_policy_object_visit_t       visit,
+                                       void                          *userdata)
+{
+    pa_assert(idx);
+    pa_assert(visit);
+
+    if (type <= pa_policy_object_min || type >= pa_policy_object_max)
+        return;
+
+    if (idx->equals[type] != NULL && name != NULL)
+        bucket_visit(pa_hashmap_get(idx->equals[type], name), visit, userdata);
+
+    bucket_visit(&idx->rest[type], visit, userdata);
+}
+
+/* visits every object of the type, whatever name it was defined with */
+void pa_policy_object_index_visit_all(struct pa_policy_object_index *idx,
+                                      enum pa_policy_object_type     type,
+                                      pa_policy_object_visit_t       visit,
+                                      void                          *userdata)
+{
+    struct pa_policy_object_list *list;
+    int                           i;
+
+    pa_assert(idx);
+    pa_assert(visit);
+
+    if (type <= pa_policy_object_min || type >= pa_policy_object_max)
+        return;
+
+    list = &idx->all[type];
+
+    for (i = 0;  i < list->nref;  i++)
+        visit(list->refs[i].object, list->refs[i].lineno, userdata);
+}
+
+
+static void bucket_append(struct pa_policy_object_bucket *bucket,
+                          struct pa_policy_object        *object,
+                          int                             lineno)
+{
+    struct pa_policy_object_ref *ref;
+
+    ref = pa_xnew0(struct pa_policy_object_ref, 1);
+    ref->object = object;
+    ref->lineno = lineno;
+
+    if (bucket->last != NULL)
+        bucket->last->next = ref;
+    else
+        bucket->first = ref;
+
+    bucket->last = ref;
+}
+
+static void list_append(struct pa_policy_object_list *list,
+                        struct pa_policy_object      *object,
+                        int                           lineno)
+{
+    struct pa_policy_object_ref *ref;
+
+    if (list->nref >= list->size) {
+        list->size = list->size ? list->size * 2 : 16;
+        list->refs = pa_xrenew(struct pa_policy_object_ref, list->refs,
+                               list->size);
+    }
+
+    ref = &list->refs[list->nref++];
+    ref->next   = NULL;
+    ref->object = object;
+    ref->lineno = lineno;
+}
+
+static void bucket_visit(struct pa_policy_object_bucket *bucket,
+                         pa_policy_object_visit_t        visit,
+                         void                           *userdata)
+{
+    struct pa_policy_object_ref *ref;
+
+    if (bucket != NULL) {
+        for (ref = bucket->first;  ref != NULL;  ref = ref->next)
+            visit(ref->object, ref->lineno, userdata);
+    }
+}
+
+static void bucket_clear(struct pa_policy_object_bucket *bucket)
+{
+    struct pa_policy_object_ref *ref;
+    struct pa_policy_object_ref *next;
+
+    for (ref = bucket->first;  ref != NULL;  ref = next) {
+        next = ref->next;
+        pa_xfree(ref);
+    }
+
+    bucket->first = NULL;
+    bucket->last  = NULL;
+}
+
+static void bucket_free(struct pa_policy_object_bucket *bucket)
+{
+    if (bucket != NULL) {
+        bucket_clear(bucket);
+
+        pa_xfree(bucket->key);
+        pa_xfree(bucket);
+    }
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,70 @@
+#ifndef foopolicyobjectindexfoo
+#define foopolicyobjectindexfoo
+
+#include <pulsecore/hashmap.h>
+
+enum pa_policy_object_type {
+    pa_policy_object_unknown = 0,
+    pa_policy_object_min = pa_policy_object_unknown,
+
+    pa_policy_object_module,
+    pa_policy_object_card,
+    pa_policy_object_sink,
+    pa_policy_object_source,
+    pa_policy_object_sink_input,
+    pa_policy_object_source_output,
+
+    pa_policy_object_max
+};
+
+struct pa_policy_object;
+
+struct pa_policy_object_ref {
+    struct pa_policy_object_ref        *next;
+    struct pa_policy_object            *object;
+    int                                 lineno;
+};
+
+struct pa_policy_object_bucket {
+    char                               *key;
+    struct pa_policy_object_ref        *first; /* in the order of definition */
+    struct pa_policy_object_ref        *last;
+};
+
+struct pa_policy_object_list {
+    struct pa_policy_object_ref        *refs;  /* array, in the order of definition */
+    int                                 nref;
+    int                                 size;
+};
+
+struct pa_policy_object_index {
+    pa_hashmap                     *equals[pa_policy_object_max]; /* name => bucket */
+    struct pa_policy_object_bucket  rest[pa_policy_object_max];   /* startswith/matches/true */
+    struct pa_policy_object_list    all[pa_policy_object_max];    /* all of the type */
+};
+
+typedef void (*pa_policy_object_visit_t)(struct pa_policy_object *, int,
+                                         void *);
+
+void pa_policy_object_index_add(struct pa_policy_object_index *,
+                                enum pa_policy_object_type, const char *,
+                                struct pa_policy_object *, int);
+void pa_policy_object_index_free(struct pa_policy_object_index *);
+void pa_policy_object_index_visit_name(struct pa_policy_object_index *,
+                                       enum pa_policy_object_type,
+                                       const char *,
+                                       pa_policy_object_visit_t, void *);
+void pa_policy_object_index_visit_all(struct pa_policy_object_index *,
+                                      enum pa_policy_object_type,
+                                      pa_policy_object_visit_t, void *);
+
+
+#endif /* foopolicyobjectindexfoo */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -0,0 +1,189 @@
+/*
+ * Registers and unregisters 50k pids in the pid hash, checking every
+ * lookup on the way and that the table grows and shrinks with the
+ * number of pids it holds.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "pid-hash.h"
+
+#define NPID    50000
+#define ROUNDS  4
+
+static pid_t  pid_of(int);
+static int    check_load(struct pa_classify_pid_table *, int);
+static void   shuffle(int *, int);
+static double now(void);
+
+
+int main(int argc, char **argv)
+{
+    struct pa_classify_pid_table  table;
+    struct pa_classify_pid_hash  *st;
+    struct pa_classify_pid_hash **link;
+    int                          *order;
+    int                           failed = 0;
+    int                           round;
+    int                           i;
+    double                        start;
+    double                        elapsed = 0.0;
+
+    (void)argc;
+    (void)argv;
+
+    srand(1);
+
+    order = malloc(NPID * sizeof(int));
+    pa_pid_hash_init(&table);
+
+    for (round = 0;   round < ROUNDS;   round++) {
+        for (i = 0;   i < NPID;   i++)
+            order[i] = i;
+
+        shuffle(order, NPID);
+
+        start = now();
+
+        for (i = 0;   i < NPID;   i++) {
+            st = pa_pid_hash_get(&table, pid_of(order[i]));
+
+            if (st->pid != pid_of(order[i])) {
+                printf("round %d: got pid %d for pid %d\n", round,
+                       (int)st->pid, (int)pid_of(order[i]));
+                failed++;
+            }
+        }
+
+        elapsed += now() - start;
+
+        if (table.count != NPID) {
+            printf("round %d: %u pids after registering %d\n", round,
+                   table.count, NPID);
+            failed++;
+        }
+
+        for (i = 0;   i < NPID;   i++) {
+            if (pa_pid_hash_get(&table, pid_of(i)) == NULL ||
+                table.count != NPID)
+            {
+                printf("round %d: pid %d registered twice\n", round,
+                       (int)pid_of(i));
+                failed++;
+                break;
+            }
+        }
+
+        failed += check_load(&table, round);
+
+        shuffle(order, NPID);
+
+        start = now();
+
+        for (i = 0;   i < NPID;   i++) {
+            if (pa_pid_hash_find(&table, pid_of(order[i]), &link) == NULL) {
+                printf("round %d: pid %d lost\n", round, (int)pid_of(order[i]));
+                failed++;
+                continue;
+            }
+
+            pa_pid_hash_remove(&table, link);
+
+            if (pa_pid_hash_find(&table, pid_of(order[i]), NULL)) {
+                printf("round %d: pid %d still found after removal\n",
+                       round, (int)pid_of(order[i]));
+                failed++;
+            }
+
+            if (i == NPID / 2)
+                failed += check_load(&table, round);
+        }
+
+        elapsed += now() - start;
+
+        if (table.count != 0 || table.size != PA_POLICY_PID_HASH_MIN) {
+            printf("round %d: %u pids in %u buckets after unregistering all\n",
+                   round, table.count, table.size);
+            failed++;
+        }
+    }
+
+    printf("%d rounds of %d pids: %.1f ns per register/unregister\n",
+           ROUNDS, NPID, elapsed * 1e9 / (ROUNDS * NPID * 2.0));
+
+    pa_pid_hash_free(&table, NULL);
+    free(order);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* spread over the pid space; the multiplier is odd, so no collisions */
+static pid_t pid_of(int i)
+{
+    return (pid_t)(1 + ((uint32_t)i * 40503U) % 4194304U);
+}
+
+/* at most two pids per bucket on average and no overlong chain */
+static int check_load(struct pa_classify_pid_table *table, int round)
+{
+    struct pa_classify_pid_hash *st;
+    uint32_t i;
+    uint32_t len;
+    uint32_t max = 0;
+
+    if (table->count > table->size * 2) {
+        printf("round %d: %u pids in %u buckets\n", round,
+               table->count, table->size);
+        return 1;
+    }
+
+    for (i = 0;   i < table->size;   i++) {
+        for (len = 0, st = table->buckets[i];   st;   st = st->next)
+            len++;
+
+        if (len > max)
+            max = len;
+    }
+
+    if (max > 16) {
+        printf("round %d: a bucket holds %u of %u pids\n", round,
+               max, table->count);
+        return 1;
+    }
+
+    return 0;
+}
+
+static void shuffle(int *v, int n)
+{
+    int i, j, t;
+
+    for (i = n - 1;   i > 0;   i--) {
+        j = rand() % (i + 1);
+        t = v[i]; v[i] = v[j]; v[j] = t;
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
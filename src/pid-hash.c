@@ -0,0 +1,169 @@
+#include <stdint.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "pid-hash.h"
+
+
+static void resize(struct pa_classify_pid_table *, uint32_t);
+
+
+void pa_pid_hash_init(struct pa_classify_pid_table *table)
+{
+    pa_assert(table);
+
+    table->size    = PA_POLICY_PID_HASH_MIN;
+    table->count   = 0;
+    table->buckets = pa_xnew0(struct pa_classify_pid_hash *, table->size);
+}
+
+void pa_pid_hash_free(struct pa_classify_pid_table *table,
+                      pa_pid_hash_free_cb_t free_rules)
+{
+    struct pa_classify_pid_hash *st;
+    uint32_t i;
+
+    pa_assert(table);
+
+    for (i = 0;   i < table->size;   i++) {
+        while ((st = table->buckets[i]) != NULL) {
+            table->buckets[i] = st->next;
+
+            if (free_rules)
+                free_rules(st);
+
+            pa_xfree(st);
+        }
+    }
+
+    pa_xfree(table->buckets);
+
+    table->buckets = NULL;
+    table->size    = 0;
+    table->count   = 0;
+}
+
+/*
+ * Returns the entry of pid, or NULL. If link_ret is given it is set to
+ * the link that points to the entry (or to the end of its bucket).
+ */
+struct
+pa_classify_pid_hash *pa_pid_hash_find(struct pa_classify_pid_table *table,
+                                       pid_t pid,
+                                       struct pa_classify_pid_hash ***link_ret)
+{
+    struct pa_classify_pid_hash *st;
+    struct pa_classify_pid_hash **link;
+
+    pa_assert(table);
+
+    for (link = &table->buckets[pid & (table->size - 1)];
+         (st = *link) != NULL;
+         link = &st->next)
+    {
+        if (pid && pid == st->pid)
+            break;
+    }
+
+    if (link_ret)
+        *link_ret = link;
+
+    return st;
+}
+
+/*
+ * Returns the entry of pid, creating an empty one if there is none.
+ * The table doubles once it holds more than two pids per bucket.
+ */
+struct
+pa_classify_pid_hash *pa_pid_hash_get(struct pa_classify_pid_table *table,
+                                      pid_t pid)
+{
+    struct pa_classify_pid_hash *st;
+    struct pa_classify_pid_hash **bucket;
+
+    pa_assert(table);
+
+    if ((st = pa_pid_hash_find(table, pid, NULL)) == NULL) {
+        st = pa_xnew0(struct pa_classify_pid_hash, 1);
+        st->pid = pid;
+
+        bucket = &table->buckets[pid & (table->size - 1)];
+        st->next = *bucket;
+        *bucket = st;
+
+        if (++table->count > table->size * 2)
+            resize(table, table->size * 2);
+    }
+
+    return st;
+}
+
+/*
+ * Unlinks and frees the entry link points to. Its rules must be gone
+ * already. The table halves once it is less than 1/8 full.
+ */
+void pa_pid_hash_remove(struct pa_classify_pid_table *table,
+                        struct pa_classify_pid_hash **link)
+{
+    struct pa_classify_pid_hash *st;
+
+    pa_assert(table);
+    pa_assert(link);
+    pa_assert_se((st = *link));
+    pa_assert(!st->rules);
+
+    *link = st->next;
+    pa_xfree(st);
+
+    if (--table->count < table->size / 8 &&
+        table->size > PA_POLICY_PID_HASH_MIN)
+        resize(table, table->size / 2);
+}
+
+
+static void resize(struct pa_classify_pid_table *table, uint32_t size)
+{
+    struct pa_classify_pid_hash **buckets;
+    struct pa_classify_pid_hash *st;
+    uint32_t i, idx;
+
+    pa_assert(table);
+    pa_assert(size >= PA_POLICY_PID_HASH_MIN);
+    pa_assert(!(size & (size - 1)));
+
+    buckets = pa_xnew0(struct pa_classify_pid_hash *, size);
+
+    for (i = 0;  i < table->size;  i++) {
+        while ((st = table->buckets[i]) != NULL) {
+            table->buckets[i] = st->next;
+
+            idx = st->pid & (size - 1);
+            st->next = buckets[idx];
+            buckets[idx] = st;
+        }
+    }
+
+    pa_log_debug("pid hash resized from %u to %u buckets (%u pids)",
+                 table->size, size, table->count);
+
+    pa_xfree(table->buckets);
+
+    table->buckets = buckets;
+    table->size    = size;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
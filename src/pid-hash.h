@@ -0,0 +1,45 @@
+#ifndef foopidhashfoo
+#define foopidhashfoo
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define PA_POLICY_PID_HASH_BITS  6
+#define PA_POLICY_PID_HASH_MIN   (1 << PA_POLICY_PID_HASH_BITS)
+
+struct pa_classify_pid_rule;
+
+struct pa_classify_pid_hash {
+    struct pa_classify_pid_hash *next;
+    pid_t                        pid;   /* process id (or parent process id) */
+    struct pa_classify_pid_rule *rules; /* in the order of registration */
+};
+
+struct pa_classify_pid_table {
+    struct pa_classify_pid_hash **buckets;
+    uint32_t                      size;  /* number of buckets, power of 2 */
+    uint32_t                      count; /* number of pids */
+};
+
+typedef void (*pa_pid_hash_free_cb_t)(struct pa_classify_pid_hash *);
+
+void pa_pid_hash_init(struct pa_classify_pid_table *);
+void pa_pid_hash_free(struct pa_classify_pid_table *, pa_pid_hash_free_cb_t);
+struct pa_classify_pid_hash *pa_pid_hash_find(struct pa_classify_pid_table *,
+                                              pid_t,
+                                              struct pa_classify_pid_hash ***);
+struct pa_classify_pid_hash *pa_pid_hash_get(struct pa_classify_pid_table *,
+                                             pid_t);
+void pa_pid_hash_remove(struct pa_classify_pid_table *,
+                        struct pa_classify_pid_hash **);
+
+
+#endif /* foopidhashfoo */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
@@ -13,6 +13,7 @@
 #include "source-output-ext.h"
 #include "classify.h"
 #include "dbusif.h"
+#include "context.h"
 
 #define MUTE   1
 #define UNMUTE 0
@@ -30,28 +31,44 @@ struct target {
 };
 
 
-struct cursor {
-    int idx;
-    struct pa_policy_group *grp;
-};
-
-
 static struct pa_sink   *defsink;
 static struct pa_source *defsource;
 static uint32_t          defsinkidx = PA_IDXSET_INVALID;
 static uint32_t          defsrcidx  = PA_IDXSET_INVALID;
 static pa_volume_t       dbtbl[300];
 
-static int move_group(struct pa_policy_group *, struct target *);
+static int move_group(struct pa_policy_groupset *, struct pa_policy_group *,
+                      struct target *);
 static int volset_group(struct userdata *, struct pa_policy_group *,
                         pa_volume_t);
-static int mute_group_by_route(struct pa_policy_group *,
+static int mute_group_by_route(struct userdata *, struct pa_policy_group *,
                                int, struct pa_null_sink *);
+static int mute_stream_by_volume(struct userdata *, struct pa_policy_group *,
+                                 struct pa_sink_input *, int);
+static int on_null_sink(struct pa_policy_group *);
+static int mute_stream_locally(struct userdata *, struct pa_policy_group *,
+                               struct pa_sink_input *, int);
+static int lazy_stream(struct pa_policy_group *, struct pa_sink_input *);
+static int mute_moves_stream(struct pa_policy_group *);
+static void catch_up_cb(pa_mainloop_api *, pa_defer_event *, void *);
+static void catch_up(struct userdata *, struct pa_sink_input *);
 static int mute_group_locally(struct userdata *, struct pa_policy_group *,int);
 static int cork_group(struct userdata *u, struct pa_policy_group *, int);
 
-static struct pa_policy_group *group_scan(struct pa_policy_groupset *,
-                                          struct cursor *);
+static void group_list_add(struct pa_policy_groupset *,
+                           struct pa_policy_group *);
+static void group_list_remove(struct pa_policy_groupset *,
+                              struct pa_policy_group *);
+static void group_array_append(struct pa_policy_group_array *,
+                               struct pa_policy_group *);
+static void group_array_remove(struct pa_policy_group_array *,
+                               struct pa_policy_group *);
+static void group_array_free(void *);
+static struct pa_policy_group_array *devmap_get(pa_hashmap *, uint32_t, int);
+static void group_set_sink(struct pa_policy_groupset *,
+                           struct pa_policy_group *, struct pa_sink *);
+static void group_set_source(struct pa_policy_groupset *,
+                             struct pa_policy_group *, struct pa_source *);
 static struct pa_policy_group *find_group_by_name(struct pa_policy_groupset *,
                                                   const char *, uint32_t *);
 
@@ -82,6 +99,20 @@ struct pa_policy_groupset *pa_policy_groupset_new(struct userdata *u)
     
     gset = pa_xnew0(struct pa_policy_groupset, 1);
 
+    gset->sinkmap = pa_hashmap_new_full(pa_idxset_trivial_hash_func,
+                                        pa_idxset_trivial_compare_func,
+                                        NULL, group_array_free);
+    gset->srcmap  = pa_hashmap_new_full(pa_idxset_trivial_hash_func,
+                                        pa_idxset_trivial_compare_func,
+                                        NULL, group_array_free);
+
+    gset->mainloop = u->core->mainloop;
+    gset->catchup  = gset->mainloop->defer_new(gset->mainloop, catch_up_cb, u);
+    gset->lagging  = pa_idxset_new(pa_idxset_trivial_hash_func,
+                                   pa_idxset_trivial_compare_func);
+
+    gset->mainloop->defer_enable(gset->catchup, 0);
+
     return gset;
 }
 
@@ -89,15 +120,31 @@ void pa_policy_groupset_free(struct pa_policy_groupset *gset)
 {
     pa_assert(gset);
 
+    pa_xfree(gset->route.groups);
+
+    if (gset->sinkmap)
+        pa_hashmap_free(gset->sinkmap);
+
+    if (gset->srcmap)
+        pa_hashmap_free(gset->srcmap);
+
+    if (gset->catchup)
+        gset->mainloop->defer_free(gset->catchup);
+
+    if (gset->lagging)
+        pa_idxset_free(gset->lagging, NULL);
+
     pa_xfree(gset);
 }
 
 void pa_policy_groupset_update_default_sink(struct userdata *u, uint32_t idx)
 {
-    struct pa_policy_groupset *gset;
-    struct pa_policy_group    *group;
-    const char                *defsinkname;
-    int                        i;
+    struct pa_policy_groupset    *gset;
+    struct pa_policy_group_array *attached;
+    struct pa_policy_group_array *detached;
+    struct pa_policy_group       *group;
+    const char                   *defsinkname;
+    int                           i;
 
     pa_assert(u);
     pa_assert_se((gset = u->groups));
@@ -110,14 +157,13 @@ void pa_policy_groupset_update_default_sink(struct userdata *u, uint32_t idx)
     if (defsink != NULL && defsinkidx == idx) {
         pa_log_debug("Unset default sink (idx=%d)", idx);
 
-        for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-            for (group = gset->hash_tbl[i]; group; group = group->next) {
-                if (group->sinkidx == defsinkidx) {
-                    pa_log_debug("  unset default sink for group '%s'",
-                                 group->name);
-                    group->sink = NULL;
-                    group->sinkidx = PA_IDXSET_INVALID;
-                }
+        if ((attached = devmap_get(gset->sinkmap, defsinkidx, false))) {
+            while (attached->ngroup > 0) {
+                group = attached->groups[0];
+
+                pa_log_debug("  unset default sink for group '%s'",
+                             group->name);
+                group_set_sink(gset, group, NULL);
             }
         }
         
@@ -139,17 +185,20 @@ void pa_policy_groupset_update_default_sink(struct userdata *u, uint32_t idx)
             pa_log_debug("Set default sink to '%s' (idx=%d)",
                          defsinkname, defsinkidx);
 
-            for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-                for (group = gset->hash_tbl[i]; group; group = group->next) {
-                    if (group->sinkname == NULL && group->sink == NULL) {
-                        pa_log_debug("  set sink '%s' as default for "
-                                     "group '%s'", defsinkname, group->name);
-                        group->sink = defsink;
-                        group->sinkidx = defsinkidx;
+            detached = devmap_get(gset->sinkmap, PA_IDXSET_INVALID, true);
 
-                        /* TODO: we should move the streams to defsink */
-                    }
+            for (i = 0;   i < detached->ngroup;  ) {
+                group = detached->groups[i];
+
+                if (group->sinkname == NULL) {
+                    pa_log_debug("  set sink '%s' as default for "
+                                 "group '%s'", defsinkname, group->name);
+                    group_set_sink(gset, group, defsink);
+
+                    /* TODO: we should move the streams to defsink */
                 }
+                else
+                    i++;
             }
         }
     }
@@ -158,11 +207,12 @@ void pa_policy_groupset_update_default_sink(struct userdata *u, uint32_t idx)
 
 void pa_policy_groupset_register_sink(struct userdata *u, struct pa_sink *sink)
 {
-    struct pa_policy_groupset *gset;
-    struct pa_policy_group    *group;
-    const char                *sinkname;
-    uint32_t                   sinkidx;
-    int                        i;
+    struct pa_policy_groupset    *gset;
+    struct pa_policy_group_array *detached;
+    struct pa_policy_group       *group;
+    const char                   *sinkname;
+    uint32_t                      sinkidx;
+    int                           i;
 
     pa_assert(u);
     pa_assert(sink);
@@ -173,57 +223,66 @@ void pa_policy_groupset_register_sink(struct userdata *u, struct pa_sink *sink)
 
     if (sinkname && sinkname[0]) {
         pa_log_debug("Register sink '%s' (idx=%d)", sinkname, sinkidx);
-        
-        for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-            for (group = gset->hash_tbl[i];    group;    group = group->next) {
-                if (group->sinkname && !strcmp(group->sinkname, sinkname)) {
-                    pa_log_debug("  set sink '%s' as default for group '%s'",
-                                 sinkname, group->name);
 
-                    group->sink    = sink;
-                    group->sinkidx = sinkidx;
+        /*
+         * sink names are unique, so only the groups that lost their
+         * sink can be waiting for this one
+         */
+        detached = devmap_get(gset->sinkmap, PA_IDXSET_INVALID, true);
+
+        for (i = 0;   i < detached->ngroup;  ) {
+            group = detached->groups[i];
 
-                    /* TODO: we should move the streams to the sink */
-                }
+            if (group->sinkname && !strcmp(group->sinkname, sinkname)) {
+                pa_log_debug("  set sink '%s' as default for group '%s'",
+                             sinkname, group->name);
+
+                group_set_sink(gset, group, sink);
+
+                /* TODO: we should move the streams to the sink */
             }
+            else
+                i++;
         }
     }
 }
 
 void pa_policy_groupset_unregister_sink(struct userdata *u, uint32_t sinkidx)
 {
-    struct pa_policy_groupset *gset;
-    struct pa_policy_group    *group;
-    int                        i;
+    struct pa_policy_groupset    *gset;
+    struct pa_policy_group_array *attached;
+    struct pa_policy_group       *group;
 
     pa_assert(u);
     pa_assert_se((gset = u->groups));
 
     pa_log_debug("Unregister sink (idx=%d)", sinkidx);
-        
-    for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-        for (group = gset->hash_tbl[i];    group;    group = group->next) {
-            if (group->sinkidx == sinkidx) {
-                pa_log_debug("  unset default sink for group '%s'",
-                             group->name);
 
-                group->sink    = NULL;
-                group->sinkidx = PA_IDXSET_INVALID;
+    if ((attached = devmap_get(gset->sinkmap, sinkidx, false))) {
+        while (attached->ngroup > 0) {
+            group = attached->groups[0];
 
-                /* TODO: we should move the streams to somewhere */
-            }
+            pa_log_debug("  unset default sink for group '%s'",
+                         group->name);
+
+            group_set_sink(gset, group, NULL);
+
+            /* TODO: we should move the streams to somewhere */
         }
+
+        pa_hashmap_remove_and_free(gset->sinkmap, PA_UINT32_TO_PTR(sinkidx));
     }
 }
 
 void pa_policy_groupset_register_source(struct userdata *u,
                                         struct pa_source *source)
 {
-    struct pa_policy_groupset *gset;
-    struct pa_policy_group    *group;
-    const char                *srcname;
-    uint32_t                   srcidx;
-    int                        i;
+    struct pa_policy_groupset    *gset;
+    struct pa_policy_group_array *detached;
+    struct pa_policy_group       *group;
+    const char                   *srcname;
+    uint32_t                      srcidx;
+    int                           i;
 
     pa_assert(u);
     pa_assert(source);
@@ -235,45 +294,49 @@ void pa_policy_groupset_register_source(struct userdata *u,
     if (srcname && srcname[0]) {
         pa_log_debug("Register source '%s' (idx=%d)", srcname, srcidx);
         
-        for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-            for (group = gset->hash_tbl[i];    group;    group = group->next) {
-                if (group->srcname && !strcmp(group->srcname, srcname)) {
-                    pa_log_debug("  set source '%s' as default for group '%s'",
-                                 srcname, group->name);
+        detached = devmap_get(gset->srcmap, PA_IDXSET_INVALID, true);
 
-                    group->source = source;
-                    group->srcidx = srcidx;
+        for (i = 0;   i < detached->ngroup;  ) {
+            group = detached->groups[i];
 
-                    /* TODO: we should move the streams to the source */
-                }
+            if (group->srcname && !strcmp(group->srcname, srcname)) {
+                pa_log_debug("  set source '%s' as default for group '%s'",
+                             srcname, group->name);
+
+                group_set_source(gset, group, source);
+
+                /* TODO: we should move the streams to the source */
             }
+            else
+                i++;
         }
     }
 }
 
 void pa_policy_groupset_unregister_source(struct userdata *u, uint32_t srcidx)
 {
-    struct pa_policy_groupset *gset;
-    struct pa_policy_group    *group;
-    int                        i;
+    struct pa_policy_groupset    *gset;
+    struct pa_policy_group_array *attached;
+    struct pa_policy_group       *group;
 
     pa_assert(u);
     pa_assert_se((gset = u->groups));
 
     pa_log_debug("Unregister source (idx=%d)", srcidx);
-        
-    for (i = 0;   i < PA_POLICY_GROUP_HASH_DIM;   i++) {
-        for (group = gset->hash_tbl[i];    group;    group = group->next) {
-            if (group->srcidx == srcidx) {
-                pa_log_debug("  unset default source for group '%s'",
-                             group->name);
 
-                group->source = NULL;
-                group->srcidx = PA_IDXSET_INVALID;
+    if ((attached = devmap_get(gset->srcmap, srcidx, false))) {
+        while (attached->ngroup > 0) {
+            group = attached->groups[0];
+
+            pa_log_debug("  unset default source for group '%s'",
+                         group->name);
+
+            group_set_source(gset, group, NULL);
                 
-                /* TODO: we should move the streams to the somwhere */
-            }
+            /* TODO: we should move the streams to the somwhere */
         }
+
+        pa_hashmap_remove_and_free(gset->srcmap, PA_UINT32_TO_PTR(srcidx));
     }
 }
 
@@ -305,16 +368,17 @@ void pa_policy_groupset_create_default_group(struct userdata *u,
 
 int pa_policy_groupset_restore_volume(struct userdata *u, struct pa_sink *sink)
 {
-    struct pa_policy_group *group;
-    struct cursor           cursor = { .idx = 0, .grp = NULL, };
+    struct pa_policy_group_array *attached;
+    struct pa_policy_group       *group;
+    int i;
     int ret = 0;
 
-    if (sink) {
-        while ((group = group_scan(u->groups, &cursor)) != NULL) {
-            if (sink == group->sink) {
-                if (mute_group_locally(u, group, UNMUTE) < 0)
-                    ret = -1;
-            }
+    if (sink && (attached = devmap_get(u->groups->sinkmap,sink->index,false))) {
+        for (i = 0;  i < attached->ngroup;  i++) {
+            group = attached->groups[i];
+
+            if (mute_group_locally(u, group, UNMUTE) < 0)
+                ret = -1;
         }
     }
 
@@ -344,15 +408,29 @@ struct pa_policy_group *pa_policy_group_new(struct userdata *u, const char *name
     group->name     = pa_xstrdup(name);
     group->limit    = PA_VOLUME_NORM;
     group->sinkname = sinkname ? pa_xstrdup(sinkname) : NULL;
-    group->sink     = sinkname ? NULL : defsink;
-    group->sinkidx  = sinkname ? PA_IDXSET_INVALID : defsinkidx;
+    group->sinkidx  = PA_IDXSET_INVALID;
     group->srcname  = srcname  ? pa_xstrdup(srcname) : NULL;
-    group->source   = srcname  ? NULL : defsource;
-    group->srcidx   = srcname  ? PA_IDXSET_INVALID : defsrcidx;
+    group->srcidx   = PA_IDXSET_INVALID;
     group->properties = properties;
 
     gset->hash_tbl[idx] = group;
 
+    group_list_add(gset, group);
+
+    /* lazy groups catch their streams up when they get uncorked */
+    if ((flags & PA_POLICY_GROUP_FLAG_LAZY_APPLY))
+        pa_sink_input_ext_follow_state(u);
+
+    group_array_append(devmap_get(gset->sinkmap, PA_IDXSET_INVALID, true),
+                       group);
+    group_array_append(devmap_get(gset->srcmap, PA_IDXSET_INVALID, true),
+                       group);
+
+    if (!sinkname)
+        group_set_sink(gset, group, defsink);
+    if (!srcname)
+        group_set_source(gset, group, defsource);
+
     pa_log_info("created group (%s|%d|%s|0x%04x)", group->name,
                 (group->limit * 100) / PA_VOLUME_NORM,
                 group->sink?group->sink->name:"<null>",
@@ -398,7 +476,8 @@ void pa_policy_group_free(struct pa_policy_groupset *gset, const char *name)
 
                             pa_sink_input_ext_set_policy_group(sinp, NULL);
 
-                            pa_xfree(sil);
+                            sil->next  = sil->prev = NULL;
+                            sil->group = NULL;
                         }
                     }
                     else {
@@ -411,12 +490,18 @@ void pa_policy_group_free(struct pa_policy_groupset *gset, const char *name)
                             sinp = sil->sink_input;
 
                             pa_sink_input_ext_set_policy_group(sinp, dnam);
+
+                            sil->group = dflt;
                             
-                            if (sil->next == NULL)
-                                sil->next = dflt->sinpls;
+                            if (sil->next == NULL) {
+                                if ((sil->next = dflt->sinpls) != NULL)
+                                    dflt->sinpls->prev = sil;
+                                break;
+                            }
                         }
                         
-                        dflt->sinpls = group->sinpls;
+                        dflt->sinpls   = group->sinpls;
+                        dflt->sinpcnt += group->sinpcnt;
                     }
                 } /* if group->sinpls != NULL */
 
@@ -427,7 +512,8 @@ void pa_policy_group_free(struct pa_policy_groupset *gset, const char *name)
 
                         pa_source_output_ext_set_policy_group(sout, NULL);
 
-                        pa_xfree(sol);
+                        sol->next  = sol->prev = NULL;
+                        sol->group = NULL;
                     }
                 } /* if group->soutls */
 
@@ -440,6 +526,13 @@ void pa_policy_group_free(struct pa_policy_groupset *gset, const char *name)
 
                 prev->next = group->next;
 
+                group_list_remove(gset, group);
+
+                group_array_remove(devmap_get(gset->sinkmap, group->sinkidx,
+                                              true), group);
+                group_array_remove(devmap_get(gset->srcmap, group->srcidx,
+                                              true), group);
+
                 pa_xfree(group);
 
                 break;
@@ -472,6 +565,8 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
 
     struct pa_policy_groupset *gset;
     struct pa_policy_group    *group, *g;
+    struct pa_policy_group_array *attached;
+    struct pa_sink_input_ext  *ext;
     struct pa_sink_input_list *sl;
     struct pa_null_sink       *ns;
     const char                *sinp_name;
@@ -479,7 +574,7 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
     int                        local_route;
     int                        local_mute;
     int                        static_route;
-    struct cursor              cursor = { .idx = 0, .grp = NULL, };
+    int                        i;
 
     pa_assert(u);
     pa_assert_se((gset = u->groups));
@@ -491,13 +586,23 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
         group = find_group_by_name(gset, name, NULL);
 
     if (group != NULL) {
+        pa_assert_se((ext = pa_sink_input_ext_lookup(u, si)));
+        pa_assert(ext->member.group == NULL);
+
         pa_sink_input_ext_set_policy_group(si, group->name);
 
-        sl = pa_xnew0(struct pa_sink_input_list, 1);
-        sl->next = group->sinpls;
+        sl = &ext->member;
+        sl->prev = NULL;
+        sl->group = group;
         sl->index = si->index;
         sl->sink_input = si;
 
+        /* the stream gets the current state of the group below */
+        memcpy(sl->epoch, group->epoch, sizeof(sl->epoch));
+
+        if ((sl->next = group->sinpls) != NULL)
+            sl->next->prev = sl;
+
         group->sinpls = sl;
 
         if (group->sink != NULL) {
@@ -507,7 +612,7 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
             local_route = flags & PA_POLICY_LOCAL_ROUTE;
             local_mute  = flags & PA_POLICY_LOCAL_MUTE;
 
-            if (group->mutebyrt & !local_route) {
+            if (on_null_sink(group) && !local_route) {
                 ns = u->nullsink;
 
                 pa_log_debug("move sink input '%s' to sink '%s'",
@@ -534,11 +639,15 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
                     pa_log_debug("stream '%s'/'%s' %scorked", group->name, sinp_name, group->corked ? "" : "un");
             }
 
-            if (local_mute) {
-                while ((g = group_scan(u->groups, &cursor)) != NULL){
-                    if (g->sink && g->sink == group->sink) {
-                        mute_group_locally(u, g, MUTE);
-                    }
+            if (group->mutebyrt && !local_route && !on_null_sink(group))
+                mute_stream_by_volume(u, group, si, MUTE);
+
+            if (local_mute && group->sink) {
+                attached = devmap_get(gset->sinkmap, group->sinkidx, true);
+
+                for (i = 0;  i < attached->ngroup;  i++) {
+                    g = attached->groups[i];
+                    mute_group_locally(u, g, MUTE);
                 }
             }
             else if (group->flags & PA_POLICY_GROUP_FLAG_LIMIT_VOLUME) {
@@ -566,56 +675,63 @@ void pa_policy_group_insert_sink_input(struct userdata      *u,
 }
 
 
-void pa_policy_group_remove_sink_input(struct userdata *u, uint32_t idx)
+void pa_policy_group_remove_sink_input(struct userdata      *u,
+                                       struct pa_sink_input *si)
 {
     static const char         *media = "audio_playback";
     struct pa_policy_group    *group;
-    struct pa_sink_input_list *prev;
+    struct pa_sink_input_ext  *ext;
     struct pa_sink_input_list *sl;
-    struct cursor              cursor = { .idx = 0, .grp = NULL, };
+    uint32_t                   idx;
 
     pa_assert(u);
     pa_assert(u->groups);
+    pa_assert(si);
 
-    while ((group = group_scan(u->groups, &cursor)) != NULL) {
-        for (prev = (struct pa_sink_input_list *)&group->sinpls;
-             prev != NULL;
-             prev = prev->next)
-        {
-            if ((sl = prev->next) != NULL && idx == sl->index) {
+    idx = si->index;
 
-                group->sinpcnt--;
+    if ((ext = pa_sink_input_ext_lookup(u, si)) == NULL ||
+        (group = (sl = &ext->member)->group) == NULL)
+    {
+        pa_log("Can't remove sink input (idx=%d): "
+               "not a member of any group", idx);
+        return;
+    }
 
-                if (group->num_moving > 0 && !sl->sink_input->sink) {
-                    pa_log_error("Removing a moving sink input %s",
-                                 pa_sink_input_ext_get_name(sl->sink_input));
-                    group->num_moving--;
-                }
+    group->sinpcnt--;
 
-                if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
-                    group->sinpcnt < 1)
-                {
-                    group->sinpcnt = 0;
+    pa_idxset_remove_by_data(u->groups->lagging, si, NULL);
 
-                    pa_log_debug("media notification: group '%s' media '%s' "
-                                 "state 'inactive'", group->name, media);
+    if (group->num_moving > 0 && !sl->sink_input->sink) {
+        pa_log_error("Removing a moving sink input %s",
+                     pa_sink_input_ext_get_name(sl->sink_input));
+        group->num_moving--;
+    }
 
-                    pa_policy_dbusif_send_media_status(u, media,group->name,0);
-                }
+    if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
+        group->sinpcnt < 1)
+    {
+        group->sinpcnt = 0;
 
-                prev->next = sl->next;
+        pa_log_debug("media notification: group '%s' media '%s' "
+                     "state 'inactive'", group->name, media);
 
-                pa_xfree(sl);
+        pa_policy_dbusif_send_media_status(u, media,group->name,0);
+    }
 
-                pa_log_debug("sink input (idx=%d) removed from group '%s'",
-                             idx, group->name);
+    if (sl->prev != NULL)
+        sl->prev->next = sl->next;
+    else
+        group->sinpls = sl->next;
 
-                return;
-            }
-        }
-    }
+    if (sl->next != NULL)
+        sl->next->prev = sl->prev;
 
-    pa_log("Can't remove sink input (idx=%d): not a member of any group", idx);
+    sl->next  = sl->prev = NULL;
+    sl->group = NULL;
+
+    pa_log_debug("sink input (idx=%d) removed from group '%s'",
+                 idx, group->name);
 }
 
 void pa_policy_group_insert_source_output(struct userdata         *u,
@@ -630,6 +746,7 @@ void pa_policy_group_insert_source_output(struct userdata         *u,
 
     struct pa_policy_groupset    *gset;
     struct pa_policy_group       *group;
+    struct pa_source_output_ext  *ext;
     struct pa_source_output_list *sl;
     const char                   *sout_name;
     const char                   *src_name;
@@ -645,13 +762,20 @@ void pa_policy_group_insert_source_output(struct userdata         *u,
         group = find_group_by_name(gset, name, NULL);
 
     if (group != NULL) {
+        pa_assert_se((ext = pa_source_output_ext_lookup(u, so)));
+        pa_assert(ext->member.group == NULL);
+
         pa_source_output_ext_set_policy_group(so, group->name);
 
-        sl = pa_xnew0(struct pa_source_output_list, 1);
-        sl->next = group->soutls;
+        sl = &ext->member;
+        sl->prev = NULL;
+        sl->group = group;
         sl->index = so->index;
         sl->source_output = so;
 
+        if ((sl->next = group->soutls) != NULL)
+            sl->next->prev = sl;
+
         group->soutls = sl;
 
         if (group->source != NULL) {
@@ -683,70 +807,74 @@ void pa_policy_group_insert_source_output(struct userdata         *u,
 }
 
 
-void pa_policy_group_remove_source_output(struct userdata *u, uint32_t idx)
+void pa_policy_group_remove_source_output(struct userdata         *u,
+                                          struct pa_source_output *so)
 {
     static const char  *media       = "audio_recording";
 
     struct pa_policy_group       *group;
-    struct pa_source_output_list *prev;
+    struct pa_source_output_ext  *ext;
     struct pa_source_output_list *sl;
-    struct cursor                 cursor = { .idx = 0, .grp = NULL, };
+    uint32_t                      idx;
 
     pa_assert(u);
     pa_assert(u->groups);
+    pa_assert(so);
 
-    while ((group = group_scan(u->groups, &cursor)) != NULL) {
-        for (prev = (struct pa_source_output_list *)&group->soutls;
-             prev != NULL;
-             prev = prev->next)
-        {
-            if ((sl = prev->next) != NULL && idx == sl->index) {
-                group->soutcnt--;
+    idx = so->index;
 
-                if (group->num_moving > 0 && !sl->source_output) {
-                    pa_log_error("Removing a moving source output %s",
-                                pa_source_output_ext_get_name(sl->source_output));
-                    group->num_moving--;
-                }
+    if ((ext = pa_source_output_ext_lookup(u, so)) == NULL ||
+        (group = (sl = &ext->member)->group) == NULL)
+    {
+        pa_log("Can't remove source output (idx=%d): "
+               "not a member of any group", idx);
+        return;
+    }
 
-                if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
-                    group->soutcnt < 1)
-                {
-                    group->soutcnt = 0;
+    group->soutcnt--;
 
-                    pa_log_debug("media notification: group '%s' media '%s' "
-                                 "state 'inactive'", group->name, media);
+    if (group->num_moving > 0 && !sl->source_output->source) {
+        pa_log_error("Removing a moving source output %s",
+                     pa_source_output_ext_get_name(sl->source_output));
+        group->num_moving--;
+    }
 
-                    pa_policy_dbusif_send_media_status(u, media,group->name,0);
-                }
+    if ((group->flags & PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY) &&
+        group->soutcnt < 1)
+    {
+        group->soutcnt = 0;
 
-                prev->next = sl->next;
+        pa_log_debug("media notification: group '%s' media '%s' "
+                     "state 'inactive'", group->name, media);
 
-                pa_xfree(sl);
+        pa_policy_dbusif_send_media_status(u, media,group->name,0);
+    }
 
-                pa_log_debug("source output (idx=%d) removed from group '%s'",
-                             idx, group->name);
+    if (sl->prev != NULL)
+        sl->prev->next = sl->next;
+    else
+        group->soutls = sl->next;
 
-                return;
-            }
-        }
-    }
+    if (sl->next != NULL)
+        sl->next->prev = sl->prev;
 
-    pa_log("Can't remove source output (idx=%d): "
-           "not a member of any group", idx);
+    sl->next  = sl->prev = NULL;
+    sl->group = NULL;
+
+    pa_log_debug("source output (idx=%d) removed from group '%s'",
+                 idx, group->name);
 }
 
 int pa_policy_group_move_to(struct userdata *u, const char *name,
                             enum pa_policy_route_class class, const char *type,
                             const char *mode, const char *hwid)
 {
-    static pa_subscription_event_type_t sinkev = PA_SUBSCRIPTION_EVENT_SINK |
-                                                 PA_SUBSCRIPTION_EVENT_CHANGE;
+    struct pa_policy_group_array *route;
     struct pa_policy_group   *grp;
     struct target             target;
     bool                 target_is_sink = false;
     int                       ret = -1;
-    struct cursor             cursor = { .idx = 0, .grp = NULL, };
+    int                       i;
 
     pa_assert(u);
 
@@ -778,32 +906,34 @@ int pa_policy_group_move_to(struct userdata *u, const char *name,
                 if (!(grp->flags & PA_POLICY_GROUP_FLAG_ROUTE_AUDIO))
                     ret = 0;
                 else
-                    ret = move_group(grp, &target) == 0 ? 1 : -1;
+                    ret = move_group(u->groups, grp, &target) == 0 ? 1 : -1;
             }
         }
         else {                  /* move all groups */
             ret = 0;
+            route = &u->groups->route;
 
-           while ((grp = group_scan(u->groups, &cursor)) != NULL) {
-                if ((grp->flags & PA_POLICY_GROUP_FLAG_ROUTE_AUDIO)) {
-                    if (move_group(grp, &target) < 0)
-                        ret = -1;
-                    else
-                        ret++;
-                }
+            for (i = 0;  i < route->ngroup;  i++) {
+                grp = route->groups[i];
+
+                if (move_group(u->groups, grp, &target) < 0)
+                    ret = -1;
+                else
+                    ret++;
             }
         }
     }
 
     /* For sink target update audio mode and accessory hwid always and
-     * fire hook. */
+     * fire hook. While the caller holds the notifications the hook is
+     * fired once per sink at the end of the transaction. */
     if (target_is_sink && target.sink) {
         pa_log_info("Broadcast mode '%s' to sink '%s'", target.mode, target.sink->name);
         pa_proplist_sets(target.sink->proplist, PA_PROP_MAEMO_AUDIO_MODE    , target.mode);
         pa_proplist_sets(target.sink->proplist, PA_PROP_MAEMO_ACCESSORY_HWID, target.hwid);
 
-        pa_subscription_post(target.sink->core, sinkev, target.sink->index);
-        pa_hook_fire(&target.sink->core->hooks[PA_CORE_HOOK_SINK_PROPLIST_CHANGED], target.sink);
+        pa_policy_context_proplist_changed(u, pa_policy_object_sink,
+                                           target.sink);
 
         /* Forward shared info. First HWID then MODE, so that when checking MODE value HWID already
          * is stored. */
@@ -817,69 +947,140 @@ int pa_policy_group_move_to(struct userdata *u, const char *name,
     return ret;
 }
 
-static int start_move_group(struct pa_policy_group *group)
+static int start_move_group(struct pa_policy_group    *group,
+                            enum pa_policy_route_class class,
+                            int                        all)
 {
     struct pa_sink_input_list    *input  = NULL;
     struct pa_source_output_list *output = NULL;
+    int                           cnt    = 0;
 
     pa_assert(group);
 
-    if (group->num_moving > 0)
-        pa_log_error("Starting to move group %s which already has moving streams", group->name);
-
-    for (input = group->sinpls; input; input = input->next) {
-        if (!input->sink_input->sink)
-            pa_log_error("Sink input %s already detached",
-                    pa_sink_input_ext_get_name(input->sink_input));
-        else {
-            pa_assert_se(pa_sink_input_start_move(input->sink_input) >= 0);
-            pa_log_debug("Starting to move sink input %s",
-                    pa_sink_input_ext_get_name(input->sink_input));
-            group->num_moving++;
+    if (class == pa_policy_route_to_sink) {
+        for (input = group->sinpls; input; input = input->next) {
+            if (!input->sink_input->sink) {
+                pa_log_debug("Sink input %s already detached",
+                        pa_sink_input_ext_get_name(input->sink_input));
+            }
+            else if (!all && lazy_stream(group, input->sink_input)) {
+                pa_log_debug("Sink input %s is corked; not detaching it",
+                        pa_sink_input_ext_get_name(input->sink_input));
+            }
+            else {
+                pa_assert_se(pa_sink_input_start_move(input->sink_input) >= 0);
+                pa_log_debug("Starting to move sink input %s",
+                        pa_sink_input_ext_get_name(input->sink_input));
+                group->num_moving++;
+                cnt++;
+            }
         }
     }
-
-    for (output = group->soutls; output; output = output->next) {
-        if (!output->source_output->source)
-            pa_log_error("Source output %s already detached",
-                    pa_source_output_ext_get_name(output->source_output));
-        else {
-            pa_assert_se(pa_source_output_start_move(output->source_output) >= 0);
-            pa_log_debug("Starting to move source output %s",
-                    pa_source_output_ext_get_name(output->source_output));
-            group->num_moving++;
+    else {
+        for (output = group->soutls; output; output = output->next) {
+            if (!output->source_output->source) {
+                pa_log_debug("Source output %s already detached",
+                        pa_source_output_ext_get_name(output->source_output));
+            }
+            else {
+                pa_assert_se(pa_source_output_start_move(output->source_output) >= 0);
+                pa_log_debug("Starting to move source output %s",
+                        pa_source_output_ext_get_name(output->source_output));
+                group->num_moving++;
+                cnt++;
+            }
         }
     }
 
-    return 0;
+    return cnt;
 }
 
-void pa_policy_group_assert_moving(struct userdata *u)
+int pa_policy_group_assert_moving(struct userdata *u)
 {
-    struct pa_policy_group *group = NULL;
-    struct cursor           cursor = { .idx = 0, .grp = NULL, };
+    struct pa_policy_group_array *route;
+    struct pa_policy_group       *group;
+    int                           i;
+    int                           cnt = 0;
+
+    /* only routed groups are ever detached for moving */
+    route = &u->groups->route;
+
+    for (i = 0;  i < route->ngroup;  i++) {
+        group = route->groups[i];
 
-    while ((group = group_scan(u->groups, &cursor)) != NULL) {
-        if (group->num_moving > 0)
+        if (group->num_moving > 0) {
             pa_log_error("Group %s still has %d moving streams",
                          group->name, group->num_moving);
+            cnt++;
+        }
     }
+
+    return cnt;
 }
 
-int pa_policy_group_start_move_all(struct userdata *u)
+/*
+ * Detach the streams of the routed groups that a routing decision is
+ * going to move: the ones whose device differs from the one the
+ * decision resolves to, and the ones whose device sits on a card that
+ * is about to change its profile. Groups that stay put keep playing.
+ * Returns the number of groups detached.
+ */
+int pa_policy_group_start_move(struct userdata *u,
+                               enum pa_policy_route_class class,
+                               const char *type, pa_idxset *cards)
 {
-    struct pa_policy_group *group = NULL;
-    struct cursor           cursor = { .idx = 0, .grp = NULL, };
+    struct pa_policy_group_array *route;
+    struct pa_policy_group       *group;
+    void                         *dest;
+    void                         *current;
+    struct pa_card               *card;
+    int                           vanishing;
+    int i;
     int ret = 0;
 
     pa_assert(u);
+    pa_assert(type);
 
-    while ((group = group_scan(u->groups, &cursor)) != NULL) {
-        if (group->flags & PA_POLICY_GROUP_FLAG_ROUTE_AUDIO) {
-            start_move_group(group);
-            ret++;
-            pa_assert(group->num_moving > 0 || group->sinpcnt + group->soutcnt == 0);
+    switch (class) {
+    case pa_policy_route_to_sink:
+        dest = find_sink_by_type(u, type);
+        break;
+    case pa_policy_route_to_source:
+        dest = find_source_by_type(u, type);
+        break;
+    default:
+        return 0;
+    }
+
+    route = &u->groups->route;
+
+    for (i = 0;  i < route->ngroup;  i++) {
+        group = route->groups[i];
+
+        if (class == pa_policy_route_to_sink) {
+            /* streams of a group muted by route stay on the null sink */
+            if (on_null_sink(group) || !group->sinpls)
+                continue;
+
+            current = group->sink;
+            card    = group->sink ? group->sink->card : NULL;
+        }
+        else {
+            if (!group->soutls)
+                continue;
+
+            current = group->source;
+            card    = group->source ? group->source->card : NULL;
         }
+
+        vanishing = card && cards && pa_idxset_get_by_data(cards, card, NULL);
+
+        if (current == dest && !vanishing)
+            continue;
+
+        /* corked streams of lazy groups stay put, unless the sink goes */
+        if (start_move_group(group, class, vanishing) > 0)
+            ret++;
     }
 
     return ret;
@@ -936,11 +1137,12 @@ int pa_policy_group_volume_limit(struct userdata *u, const char *name,
             if (!(group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE))
                 ret = volset_group(u, group, percent);
             else {
-                if (ns->sink == NULL)
+                if (ns->sink == NULL &&
+                    !(group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME))
                     ret = volset_group(u, group, percent);
                 else {
                     mute = percent > 0 ? false : true;
-                    ret  = mute_group_by_route(group, mute, ns); 
+                    ret  = mute_group_by_route(u, group, mute, ns); 
                     
                     if (!mute)
                         volset_group(u, group, percent);
@@ -952,32 +1154,107 @@ int pa_policy_group_volume_limit(struct userdata *u, const char *name,
     return ret;
 }
 
-static struct pa_policy_group *group_scan(struct pa_policy_groupset *gset,
-                                          struct cursor *cursor)
+static void group_list_add(struct pa_policy_groupset *gset,
+                           struct pa_policy_group    *group)
 {
-    struct pa_policy_group *grp;
+    if (group->flags & PA_POLICY_GROUP_FLAG_ROUTE_AUDIO)
+        group_array_append(&gset->route, group);
+}
 
-    pa_assert(gset);
-    pa_assert(cursor);
+static void group_list_remove(struct pa_policy_groupset *gset,
+                              struct pa_policy_group    *group)
+{
+    group_array_remove(&gset->route, group);
+}
+
+static void group_array_append(struct pa_policy_group_array *list,
+                               struct pa_policy_group       *group)
+{
+    list->groups = pa_xrealloc(list->groups,
+                               sizeof(list->groups[0]) * (list->ngroup + 1));
+    list->groups[list->ngroup++] = group;
+}
 
-    for (;;) {
-        if (cursor->grp) {
-            grp = cursor->grp;
-            cursor->grp = grp->next;
-            return grp;
+static void group_array_remove(struct pa_policy_group_array *list,
+                               struct pa_policy_group       *group)
+{
+    int i;
+
+    for (i = 0;  i < list->ngroup;  i++) {
+        if (list->groups[i] == group) {
+            list->ngroup--;
+            memmove(list->groups + i, list->groups + i + 1,
+                    sizeof(list->groups[0]) * (list->ngroup - i));
+            break;
         }
+    }
+}
+
+static void group_array_free(void *data)
+{
+    struct pa_policy_group_array *list = data;
+
+    if (list != NULL) {
+        pa_xfree(list->groups);
+        pa_xfree(list);
+    }
+}
+
+/*
+ * groups routed to a device are kept in a per-device array keyed by
+ * the device index; groups without a device are in the
+ * PA_IDXSET_INVALID slot
+ */
+static struct pa_policy_group_array *devmap_get(pa_hashmap *map,
+                                                uint32_t    idx,
+                                                int         create)
+{
+    struct pa_policy_group_array *list;
+
+    if (!(list = pa_hashmap_get(map, PA_UINT32_TO_PTR(idx))) && create) {
+        list = pa_xnew0(struct pa_policy_group_array, 1);
+        pa_hashmap_put(map, PA_UINT32_TO_PTR(idx), list);
+    }
 
-        if (cursor->idx >= PA_POLICY_GROUP_HASH_DIM)
-            return NULL;
+    return list;
+}
+
+static void group_set_sink(struct pa_policy_groupset *gset,
+                           struct pa_policy_group    *group,
+                           struct pa_sink            *sink)
+{
+    uint32_t idx = sink ? sink->index : PA_IDXSET_INVALID;
+
+    if (idx != group->sinkidx) {
+        group_array_remove(devmap_get(gset->sinkmap, group->sinkidx, true),
+                           group);
+        group_array_append(devmap_get(gset->sinkmap, idx, true), group);
+    }
+
+    group->sink    = sink;
+    group->sinkidx = idx;
+}
+
+static void group_set_source(struct pa_policy_groupset *gset,
+                             struct pa_policy_group    *group,
+                             struct pa_source          *source)
+{
+    uint32_t idx = source ? source->index : PA_IDXSET_INVALID;
 
-        while (cursor->idx < PA_POLICY_GROUP_HASH_DIM &&
-               (cursor->grp = gset->hash_tbl[cursor->idx++]) == NULL)
-            ;
+    if (idx != group->srcidx) {
+        group_array_remove(devmap_get(gset->srcmap, group->srcidx, true),
+                           group);
+        group_array_append(devmap_get(gset->srcmap, idx, true), group);
     }
+
+    group->source = source;
+    group->srcidx = idx;
 }
 
 
-static int move_group(struct pa_policy_group *group, struct target *target)
+static int move_group(struct pa_policy_groupset *gset,
+                      struct pa_policy_group    *group,
+                      struct target             *target)
 {
     struct pa_sink               *sink;
     struct pa_source             *source;
@@ -999,20 +1276,31 @@ static int move_group(struct pa_policy_group *group, struct target *target)
         sinkname = pa_sink_ext_get_name(sink);
 
         if (sink == group->sink && group->num_moving == 0) {
-            if (!group->mutebyrt) {
+            if (!on_null_sink(group)) {
                 pa_log_debug("group '%s' is aready routed to sink '%s'",
                              group->name, sinkname);
             }
         } else {
             pa_xfree(group->sinkname);
             group->sinkname = pa_xstrdup(sinkname);
-            group->sink = sink;
-            group->sinkidx = sink->index;
+            group_set_sink(gset, group, sink);
+
+            group->epoch[pa_policy_group_epoch_route]++;
 
-            if (!group->mutebyrt) {
+            if (!on_null_sink(group)) {
                 for (sil = group->sinpls; sil; sil = sil->next) {
                     sinp = sil->sink_input;
 
+                    if (lazy_stream(group, sinp)) {
+                        pa_log_debug("sink input '%s' is corked; moving it "
+                                     "when it plays",
+                                     pa_sink_input_ext_get_name(sinp));
+                        continue;
+                    }
+
+                    sil->epoch[pa_policy_group_epoch_route] =
+                        group->epoch[pa_policy_group_epoch_route];
+
                     pa_log_debug("move sink input '%s' to sink '%s'",
                                  pa_sink_input_ext_get_name(sinp),
                                  sinkname);
@@ -1037,22 +1325,6 @@ static int move_group(struct pa_policy_group *group, struct target *target)
             }
         }
 
-        for (sol = group->soutls; sol; sol = sol->next) {
-            sout = sol->source_output;
-            if (!sout->source) {
-                pa_log_debug("Re-attaching %s to %s",
-                             pa_source_output_ext_get_name(sout),
-                             pa_source_ext_get_name(group->source));
-                if (pa_source_output_finish_move(sout, group->source, true) < 0) {
-                    ret = -1;
-                    pa_log_error("Failed to re-attach %s to %s",
-                                 pa_source_output_ext_get_name(sout),
-                                 pa_source_ext_get_name(group->source));
-                } else
-                    group->num_moving--;
-            }
-        }
-
         /*
          * Ideally, group->num_moving == 0 at this point,
          * but maybe > 0 if errors occurred
@@ -1070,7 +1342,7 @@ static int move_group(struct pa_policy_group *group, struct target *target)
             pa_log_debug("group '%s' is aready routed to source '%s'",
                          group->name, pa_source_ext_get_name(source));
         } else {
-            group->source = source;
+            group_set_source(gset, group, source);
 
             for (sol = group->soutls; sol; sol = sol->next) {
                 sout = sol->source_output;
@@ -1156,9 +1428,6 @@ static int volset_group(struct userdata        *u,
     pa_volume_t limit;
     struct pa_sink_input_list *sl;
     struct pa_sink_input *sinp;
-    struct pa_sink *sink;
-    struct pa_sink_ext *ext;
-    int vset;
     int retval;
 
     limit  = ((percent > 100 ? 100 : percent) * PA_VOLUME_NORM) / 100;
@@ -1170,24 +1439,23 @@ static int volset_group(struct userdata        *u,
     }
     else {
         group->limit = limit;
+        group->epoch[pa_policy_group_epoch_limit]++;
 
         if (!group->locmute) {
             for (sl = group->sinpls;   sl != NULL;   sl = sl->next) {
                 sinp = sl->sink_input;
-                vset = pa_sink_input_ext_set_volume_limit(u, sinp, limit);
 
-                if (vset < 0)
-                    retval = -1;
-                else {
-                    sink = sinp->sink;
-                    ext  = pa_sink_ext_lookup(u, sink);
+                if (lazy_stream(group, sinp))
+                    continue;
 
-                    pa_assert(ext);
+                sl->epoch[pa_policy_group_epoch_limit] =
+                    group->epoch[pa_policy_group_epoch_limit];
 
+                if (pa_sink_input_ext_set_volume_limit(u, sinp, limit) < 0)
+                    retval = -1;
+                else {
                     pa_log_debug("set volume limit %d for sink input '%s'",
                                  percent, pa_sink_input_ext_get_name(sinp));
-
-                    ext->need_volume_setting |= vset;
                 }
             }
         }
@@ -1197,7 +1465,8 @@ static int volset_group(struct userdata        *u,
 }
 
 
-static int mute_group_by_route(struct pa_policy_group *group,
+static int mute_group_by_route(struct userdata        *u,
+                               struct pa_policy_group *group,
                                int                     mute,
                                struct pa_null_sink    *ns)
 {
@@ -1207,6 +1476,28 @@ static int mute_group_by_route(struct pa_policy_group *group,
     const char *sink_name;
     int ret = 0;
 
+    if (group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME) {
+        if ((mute && group->mutebyrt) || (!mute && !group->mutebyrt)) {
+            pa_log_debug("group '%s' is already %smuted by volume",
+                         group->name, mute ? "" : "un");
+        }
+        else {
+            pa_log_debug("group '%s' %smuted by volume", group->name,
+                         mute ? "" : "un");
+
+            group->mutebyrt = mute;
+
+            if (!group->locmute) {
+                for (sl = group->sinpls;   sl != NULL;   sl = sl->next) {
+                    if (mute_stream_by_volume(u,group,sl->sink_input,mute) < 0)
+                        ret = -1;
+                }
+            }
+        }
+
+        return ret;
+    }
+
     sink = mute ? ns->sink : group->sink;
 
     if (sink == NULL) {
@@ -1252,15 +1543,7 @@ static int mute_group_locally(struct userdata        *u,
 {
     struct pa_sink_input_list *sl;
     struct pa_sink_input *sinp;
-    struct pa_sink_input_ext *ext;
-    struct pa_sink *sink;
-    const char *sink_name;
-    const char *sinp_name;
-    pa_volume_t volume;
     int mutebyrt;
-    int mark;
-    int mute;
-    int percent;
     const char *prefix;
     const char *method;
     int ret = 0;
@@ -1268,6 +1551,7 @@ static int mute_group_locally(struct userdata        *u,
 
     if (locmute != group->locmute) {
         group->locmute = locmute;
+        group->epoch[pa_policy_group_epoch_mute]++;
 
         mutebyrt = group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE;
         prefix   = locmute  ? "" : "un";
@@ -1278,64 +1562,266 @@ static int mute_group_locally(struct userdata        *u,
 
         for (sl = group->sinpls;   sl != NULL;   sl = sl->next) {
             sinp = sl->sink_input;
-            ext  = pa_sink_input_ext_lookup(u, sinp);
-            mark = (ext && ext->local.mute);
-            mute = mark ? !locmute : locmute;
-            sink = mute ? u->nullsink->sink : group->sink;
 
-            sink_name = sink ? pa_sink_ext_get_name(sink) : "<unknown sink>";
-            sinp_name = pa_sink_input_ext_get_name(sinp);
+            if (lazy_stream(group, sinp))
+                continue;
 
-            if (mutebyrt)
-                volume = group->limit;
-            else
-                volume = mute ? 0 : (mark ? PA_VOLUME_NORM : group->limit);
+            /* this sets the volume limit as well */
+            sl->epoch[pa_policy_group_epoch_mute] =
+                group->epoch[pa_policy_group_epoch_mute];
+            sl->epoch[pa_policy_group_epoch_limit] =
+                group->epoch[pa_policy_group_epoch_limit];
 
-            percent = (volume * 100) / PA_VOLUME_NORM;
+            if (mute_stream_locally(u, group, sinp, locmute) < 0)
+                ret = -1;
+        }
+    }
 
-            
-            if (mutebyrt && sink && sink != sinp->sink) {
+    return ret;
+}
 
-                pa_log_debug("moving stream '%s'/'%s' to sink '%s'",
-                             group->name, sinp_name, sink_name);
+static int mute_stream_locally(struct userdata        *u,
+                               struct pa_policy_group *group,
+                               struct pa_sink_input   *sinp,
+                               int                     locmute)
+{
+    struct pa_sink_input_ext *ext;
+    struct pa_sink *sink;
+    const char *sink_name;
+    const char *sinp_name;
+    pa_volume_t volume;
+    int mutebyrt;
+    int mark;
+    int mute;
+    int percent;
+    int ret = 0;
 
-                if (sinp->sink) {
-                    if (pa_sink_input_move_to(sinp, sink, true) < 0)
-                        ret = -1;
-                } else {
-                    pa_log_debug("stream '%s'/'%s' is currently moving. finishing move",
-                            group->name, sinp_name);
-                    if (pa_sink_input_finish_move(sinp, sink, true) < 0)
-                        ret = -1;
-                    else {
-                        pa_assert(group->num_moving > 0);
-                        group->num_moving--;
-                    }
-                }
+    mutebyrt = group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE;
 
-                if (ret == 0)
-                    pa_log_debug("stream '%s'/'%s' is now at sink '%s'",
-                            group->name, sinp_name, sink_name);
-                else
-                    pa_log_error("failed to move stream'%s'/'%s' to sink '%s'",
-                            group->name, sinp_name, sink_name);
-            }
+    ext  = pa_sink_input_ext_lookup(u, sinp);
+    mark = (ext && ext->local.mute);
+    mute = mark ? !locmute : locmute;
+    sink = mute ? u->nullsink->sink : group->sink;
+
+    sink_name = sink ? pa_sink_ext_get_name(sink) : "<unknown sink>";
+    sinp_name = pa_sink_input_ext_get_name(sinp);
+
+    if (mutebyrt)
+        volume = group->limit;
+    else
+        volume = mute ? 0 : (mark ? PA_VOLUME_NORM : group->limit);
+
+    percent = (volume * 100) / PA_VOLUME_NORM;
+
+    if (mutebyrt && (group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME)) {
+        if (mute_stream_by_volume(u, group, sinp, mute) < 0)
+            ret = -1;
+    }
+    else if (mutebyrt && sink && sink != sinp->sink) {
 
-            pa_log_debug("set volume limit %d for sink input '%s'/'%s'",
-                         percent, group->name, sinp_name);
+        pa_log_debug("moving stream '%s'/'%s' to sink '%s'",
+                     group->name, sinp_name, sink_name);
 
-            if (pa_sink_input_ext_set_volume_limit(u, sinp, volume) < 0)
+        if (sinp->sink) {
+            if (pa_sink_input_move_to(sinp, sink, true) < 0)
+                ret = -1;
+        } else {
+            pa_log_debug("stream '%s'/'%s' is currently moving. finishing move",
+                    group->name, sinp_name);
+            if (pa_sink_input_finish_move(sinp, sink, true) < 0)
                 ret = -1;
             else {
-                pa_log_debug("now volume limit %d for sink input '%s'/'%s'",
-                             percent, group->name, sinp_name);
+                pa_assert(group->num_moving > 0);
+                group->num_moving--;
             }
         }
+
+        if (ret == 0)
+            pa_log_debug("stream '%s'/'%s' is now at sink '%s'",
+                    group->name, sinp_name, sink_name);
+        else
+            pa_log_error("failed to move stream'%s'/'%s' to sink '%s'",
+                    group->name, sinp_name, sink_name);
+    }
+
+    pa_log_debug("set volume limit %d for sink input '%s'/'%s'",
+                 percent, group->name, sinp_name);
+
+    if (pa_sink_input_ext_set_volume_limit(u, sinp, volume) < 0)
+        ret = -1;
+    else {
+        pa_log_debug("now volume limit %d for sink input '%s'/'%s'",
+                     percent, group->name, sinp_name);
+    }
+
+    return ret;
+}
+
+/*
+ * mute-by-route without moving the stream: a zero volume factor keeps
+ * it on its sink. Groups flagged mute_cork also get their streams
+ * corked while muted, unless the group is corked by policy anyway.
+ */
+static int mute_stream_by_volume(struct userdata        *u,
+                                 struct pa_policy_group *group,
+                                 struct pa_sink_input   *sinp,
+                                 int                     mute)
+{
+    const char *sinp_name = pa_sink_input_ext_get_name(sinp);
+    int         ret;
+
+    pa_log_debug("stream '%s'/'%s' %smuted by volume",
+                 group->name, sinp_name, mute ? "" : "un");
+
+    ret = pa_sink_input_ext_set_factor_mute(u, sinp, mute);
+
+    if ((group->flags & PA_POLICY_GROUP_FLAG_MUTE_CORK) &&
+        (mute || !group->corked))
+    {
+        if (pa_sink_input_ext_cork(u, sinp, mute))
+            pa_log_debug("stream '%s'/'%s' %scorked while muted",
+                         group->name, sinp_name, mute ? "" : "un");
     }
 
     return ret;
 }
 
+/* local muting of mute-by-route groups moves the stream to the null sink */
+static int mute_moves_stream(struct pa_policy_group *group)
+{
+    return (group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE) &&
+           !(group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME);
+}
+
+static int on_null_sink(struct pa_policy_group *group)
+{
+    return group->mutebyrt &&
+           !(group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME);
+}
+
+/*
+ * Lazy groups leave their corked (but attached) streams alone; those
+ * keep the epochs of the last change they saw and catch up later.
+ */
+static int lazy_stream(struct pa_policy_group *group,
+                       struct pa_sink_input   *sinp)
+{
+    return (group->flags & PA_POLICY_GROUP_FLAG_LAZY_APPLY) && sinp->sink &&
+           pa_sink_input_get_state(sinp) == PA_SINK_INPUT_CORKED;
+}
+
+void pa_policy_group_catch_up_sink_input(struct userdata      *u,
+                                         struct pa_sink_input *sinp)
+{
+    struct pa_policy_groupset *gset;
+    struct pa_sink_input_ext  *ext;
+    struct pa_sink_input_list *sl;
+    struct pa_policy_group    *group;
+    uint32_t                  *have;
+    uint32_t                  *want;
+
+    pa_assert(u);
+    pa_assert_se((gset = u->groups));
+    pa_assert(sinp);
+
+    if ((ext = pa_sink_input_ext_lookup(u, sinp)) == NULL ||
+        (group = (sl = &ext->member)->group) == NULL)
+        return;
+
+    have = sl->epoch;
+    want = group->epoch;
+
+    /*
+     * the stream is about to play: set its volume right away so that
+     * not a single buffer goes out with a stale limit or mute
+     */
+    if (have[pa_policy_group_epoch_mute] != want[pa_policy_group_epoch_mute]) {
+        if (!mute_moves_stream(group)) {
+            mute_stream_locally(u, group, sinp, group->locmute);
+            have[pa_policy_group_epoch_mute] = want[pa_policy_group_epoch_mute];
+            /* the local mute sets the limit as well */
+            have[pa_policy_group_epoch_limit] =
+                want[pa_policy_group_epoch_limit];
+        }
+    }
+    else if (have[pa_policy_group_epoch_limit] !=
+             want[pa_policy_group_epoch_limit])
+    {
+        if (!group->locmute)
+            pa_sink_input_ext_set_volume_limit(u, sinp, group->limit);
+        have[pa_policy_group_epoch_limit] = want[pa_policy_group_epoch_limit];
+    }
+
+    if (memcmp(have, want, sizeof(sl->epoch))) {
+        /*
+         * this is called from the stream's state change hook;
+         * do the moving from the main loop
+         */
+        pa_idxset_put(gset->lagging, sinp, NULL);
+        gset->mainloop->defer_enable(gset->catchup, 1);
+    }
+}
+
+static void catch_up_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata)
+{
+    struct userdata           *u = userdata;
+    struct pa_policy_groupset *gset;
+    struct pa_sink_input      *sinp;
+
+    pa_assert(u);
+    pa_assert_se((gset = u->groups));
+
+    m->defer_enable(e, 0);
+
+    while ((sinp = pa_idxset_steal_first(gset->lagging, NULL)) != NULL) {
+        if (pa_sink_input_get_state(sinp) != PA_SINK_INPUT_CORKED)
+            catch_up(u, sinp);
+    }
+}
+
+static void catch_up(struct userdata *u, struct pa_sink_input *sinp)
+{
+    struct pa_sink_input_ext  *ext;
+    struct pa_sink_input_list *sl;
+    struct pa_policy_group    *group;
+    uint32_t                  *have;
+    uint32_t                  *want;
+
+    if ((ext = pa_sink_input_ext_lookup(u, sinp)) == NULL ||
+        (group = (sl = &ext->member)->group) == NULL)
+        return;
+
+    have = sl->epoch;
+    want = group->epoch;
+
+    pa_log_debug("catching up stream '%s'/'%s'", group->name,
+                 pa_sink_input_ext_get_name(sinp));
+
+    if (have[pa_policy_group_epoch_route] != want[pa_policy_group_epoch_route]) {
+        if (group->sink && sinp->sink && sinp->sink != group->sink &&
+            !on_null_sink(group))
+        {
+            pa_log_debug("move sink input '%s' to sink '%s'",
+                         pa_sink_input_ext_get_name(sinp),
+                         pa_sink_ext_get_name(group->sink));
+
+            if (pa_sink_input_move_to(sinp, group->sink, true) < 0) {
+                pa_log_error("Failed to move %s to %s",
+                             pa_sink_input_ext_get_name(sinp),
+                             pa_sink_ext_get_name(group->sink));
+            }
+        }
+    }
+
+    if (have[pa_policy_group_epoch_mute] != want[pa_policy_group_epoch_mute])
+        mute_stream_locally(u, group, sinp, group->locmute);
+    else if (have[pa_policy_group_epoch_limit] !=
+             want[pa_policy_group_epoch_limit] && !group->locmute)
+        pa_sink_input_ext_set_volume_limit(u, sinp, group->limit);
+
+    memcpy(have, want, sizeof(sl->epoch));
+}
+
 
 static int cork_group(struct userdata *u, struct pa_policy_group *group, int corked)
 {
@@ -1354,6 +1840,12 @@ static int cork_group(struct userdata *u, struct pa_policy_group *group, int cor
         for (sl = group->sinpls;    sl;   sl = sl->next) {
             sinp = sl->sink_input;
 
+            /* streams corked for mute-by-volume stay corked until unmuted */
+            if (!corked && group->mutebyrt &&
+                (group->flags & PA_POLICY_GROUP_FLAG_MUTE_CORK) &&
+                (group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME))
+                continue;
+
             changed = pa_sink_input_ext_cork(u, sinp, corked);
 
             if (changed)
@@ -1390,40 +1882,45 @@ static struct pa_policy_group *find_group_by_name(struct pa_policy_groupset *gse
 
 static struct pa_sink *find_sink_by_type(struct userdata *u, const char *type)
 {
-    void            *state = NULL;
-    pa_idxset       *idxset;
+    pa_idxset       *sinks;
     struct pa_sink  *sink;
+    struct pa_sink  *first = NULL;
+    uint32_t         idx;
 
     pa_assert(u);
     pa_assert(type);
-    pa_assert(u->core);
-    pa_assert_se((idxset = u->core->sinks));
 
-    while ((sink = pa_idxset_iterate(idxset, &state, NULL)) != NULL) {
-        if (pa_classify_is_sink_typeof(u, sink, type, NULL))
-            break;
+    /* the first one in the core's order, i.e. the lowest index */
+    if ((sinks = pa_classify_type_members(u, type, pa_classify_member_sink))) {
+        PA_IDXSET_FOREACH(sink, sinks, idx) {
+            if (!first || sink->index < first->index)
+                first = sink;
+        }
     }
 
-    return sink;
+    return first;
 }
 
 static struct pa_source *find_source_by_type(struct userdata *u, const char *type)
 {
-    void              *state = NULL;
-    pa_idxset         *idxset;
+    pa_idxset         *sources;
     struct pa_source  *source;
+    struct pa_source  *first = NULL;
+    uint32_t           idx;
 
     pa_assert(u);
     pa_assert(type);
-    pa_assert(u->core);
-    pa_assert_se((idxset = u->core->sources));
 
-    while ((source = pa_idxset_iterate(idxset, &state, NULL)) != NULL) {
-        if (pa_classify_is_source_typeof(u, source, type, NULL))
-            break;
+    /* the first one in the core's order, i.e. the lowest index */
+    if ((sources = pa_classify_type_members(u, type,
+                                            pa_classify_member_source))) {
+        PA_IDXSET_FOREACH(source, sources, idx) {
+            if (!first || source->index < first->index)
+                first = source;
+        }
     }
 
-    return source;
+    return first;
 }
 
 static uint32_t hash_value(const char *s)
@@ -20,20 +20,44 @@
 #define PA_POLICY_GROUP_FLAG_CORK_STREAM   PA_POLICY_GROUP_BIT(4)
 #define PA_POLICY_GROUP_FLAG_MEDIA_NOTIFY  PA_POLICY_GROUP_BIT(5)
 #define PA_POLICY_GROUP_FLAG_MUTE_BY_ROUTE PA_POLICY_GROUP_BIT(6)
+#define PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME PA_POLICY_GROUP_BIT(7)
+#define PA_POLICY_GROUP_FLAG_MUTE_CORK     PA_POLICY_GROUP_BIT(8)
+#define PA_POLICY_GROUP_FLAG_LAZY_APPLY    PA_POLICY_GROUP_BIT(9)
 
 #define PA_POLICY_GROUP_FLAGS_CLIENT      (PA_POLICY_GROUP_FLAG_LIMIT_VOLUME |\
                                            PA_POLICY_GROUP_FLAG_CORK_STREAM  )
 
 #define PA_POLICY_GROUP_FLAGS_NOPOLICY     PA_POLICY_GROUP_FLAG_NONE
 
+/*
+ * versions of the desired state of a group; a stream that missed a
+ * change while corked has an older version than its group and gets
+ * caught up when it starts to play
+ */
+enum pa_policy_group_epoch {
+    pa_policy_group_epoch_route = 0,  /* sink of the group */
+    pa_policy_group_epoch_limit,      /* volume limit */
+    pa_policy_group_epoch_mute,       /* local mute */
+    pa_policy_group_epoch_max
+};
+
+/*
+ * group membership nodes; they are embedded in the sink input and
+ * source output extensions so insertion and removal need no lookups
+ */
 struct pa_sink_input_list {
     struct pa_sink_input_list    *next;
+    struct pa_sink_input_list    *prev;
+    struct pa_policy_group       *group;    /* NULL if not in any group */
     uint32_t                      index;
     struct pa_sink_input         *sink_input;
+    uint32_t                      epoch[pa_policy_group_epoch_max];
 };
 
 struct pa_source_output_list {
     struct pa_source_output_list *next;
+    struct pa_source_output_list *prev;
+    struct pa_policy_group       *group;    /* NULL if not in any group */
     uint32_t                      index;
     struct pa_source_output      *source_output;
 };
@@ -59,11 +83,24 @@ struct pa_policy_group {
     int                           soutcnt;  /* source output counter */
     int                           num_moving;   /* Number of moving streams */
     pa_proplist                  *properties;   /* properties to set for each sink input*/
+    uint32_t                      epoch[pa_policy_group_epoch_max];
+};
+
+struct pa_policy_group_array {
+    struct pa_policy_group   **groups;
+    int                        ngroup;
 };
 
 struct pa_policy_groupset {
-    struct pa_policy_group    *dflt;     /*  default group */
-    struct pa_policy_group    *hash_tbl[PA_POLICY_GROUP_HASH_DIM];
+    struct pa_policy_group      *dflt;     /*  default group */
+    struct pa_policy_group      *hash_tbl[PA_POLICY_GROUP_HASH_DIM];
+    struct pa_policy_group_array route;    /* PA_POLICY_GROUP_FLAG_ROUTE_AUDIO
+                                              groups, in creation order */
+    pa_hashmap                  *sinkmap;  /* sink index => group array */
+    pa_hashmap                  *srcmap;   /* source index => group array */
+    pa_mainloop_api             *mainloop;
+    pa_defer_event              *catchup;  /* moves uncorked streams */
+    pa_idxset                   *lagging;  /* pa_sink_input *s to move */
 };
 
 enum pa_policy_route_class {
@@ -92,19 +129,24 @@ struct pa_policy_group *pa_policy_group_find(struct userdata *, const char *);
 
 void pa_policy_group_insert_sink_input(struct userdata *, const char *,
                                        struct pa_sink_input *, uint32_t);
-void pa_policy_group_remove_sink_input(struct userdata *, uint32_t);
+void pa_policy_group_remove_sink_input(struct userdata *,
+                                       struct pa_sink_input *);
 
 
 void pa_policy_group_insert_source_output(struct userdata *, const char *,
                                           struct pa_source_output *);
-void pa_policy_group_remove_source_output(struct userdata *, uint32_t);
+void pa_policy_group_remove_source_output(struct userdata *,
+                                          struct pa_source_output *);
 
 /* Return number of successfully moved groups on success, or -1 on failure. */
 int  pa_policy_group_move_to(struct userdata *, const char *,
                              enum pa_policy_route_class, const char *,
                              const char *, const char *);
-int  pa_policy_group_start_move_all(struct userdata *u);
-void pa_policy_group_assert_moving(struct userdata *u);
+int  pa_policy_group_start_move(struct userdata *, enum pa_policy_route_class,
+                                const char *, pa_idxset *);
+int  pa_policy_group_assert_moving(struct userdata *u);
+void pa_policy_group_catch_up_sink_input(struct userdata *,
+                                         struct pa_sink_input *);
 int  pa_policy_group_cork(struct userdata *u, const char *, int);
 int  pa_policy_group_volume_limit(struct userdata *, const char *, uint32_t);
 
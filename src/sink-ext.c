@@ -237,6 +237,7 @@ int pa_sink_ext_set_ports(struct userdata *u, const char *type)
     struct pa_classify_port_entry *port_entry;
     char *port;
     struct pa_sink_ext *ext;
+    pa_idxset *sinks;
     uint32_t idx;
 
     pa_assert(u);
@@ -244,7 +245,13 @@ int pa_sink_ext_set_ports(struct userdata *u, const char *type)
 
     set_port_start(u);
 
-    PA_IDXSET_FOREACH(sink, u->core->sinks, idx) {
+    if (!(sinks = pa_classify_type_members(u, type,
+                                           pa_classify_member_port_sink))) {
+        set_port_end(u);
+        return ret;
+    }
+
+    PA_IDXSET_FOREACH(sink, sinks, idx) {
         /* Check whether the port of this sink should be changed. */
         if (pa_classify_is_port_sink_typeof(u, sink, type, &data)) {
 
@@ -281,28 +288,6 @@ int pa_sink_ext_set_ports(struct userdata *u, const char *type)
     return ret;
 }
 
-void pa_sink_ext_set_volumes(struct userdata *u)
-{
-    struct pa_sink     *sink;
-    struct pa_sink_ext *ext;
-    uint32_t            idx;
-
-    pa_assert(u);
-    pa_assert(u->core);
-
-    PA_IDXSET_FOREACH(sink, u->core->sinks, idx) {
-        ext = pa_sink_ext_lookup(u, sink);
-
-        pa_assert(ext);
-
-        if (ext->need_volume_setting) {
-            pa_log_debug("set sink '%s' volume", pa_sink_ext_get_name(sink));
-            pa_sink_set_volume(sink, NULL, true, false);
-            ext->need_volume_setting = false;
-        }
-    }
-}
-
 void pa_sink_ext_override_port(struct userdata *u, struct pa_sink *sink,
                                char *port)
 {
@@ -410,18 +395,18 @@ static pa_hook_result_t sink_unlink(void *hook_data, void *call_data,
 static void handle_new_sink(struct userdata *u, struct pa_sink *sink)
 {
     const char *name;
+    char     *typelist;
     uint32_t  idx;
-    char      buf[1024];
-    int       len;
     int       ret;
     int       is_null_sink;
     struct pa_null_sink *ns;
     struct pa_sink_ext  *ext;
+    struct pa_classify_typeset *ts;
 
     if (sink && u) {
         name = pa_sink_ext_get_name(sink);
         idx  = sink->index;
-        len  = pa_classify_sink(u, sink, 0,0, buf, sizeof(buf));
+        ts   = pa_classify_sink(u, sink);
         ns   = u->nullsink;
 
         if (strcmp(name, ns->name))
@@ -436,13 +421,19 @@ static void handle_new_sink(struct userdata *u, struct pa_sink *sink)
         pa_policy_context_register(u, pa_policy_object_sink, name, sink);
         pa_policy_activity_register(u, pa_policy_object_sink, name, sink);
 
-        if (len <= 0) {
+        ext = pa_xmalloc0(sizeof(struct pa_sink_ext));
+        ext->typeset = ts;
+        pa_index_hash_add(u->hsnk, idx, ext);
+        pa_classify_index_sink(u, sink, ts);
+
+        if (pa_classify_typeset_empty(ts)) {
             if (!is_null_sink)
                 pa_log_debug("new sink '%s' (idx=%d)", name, idx);
         }
         else {
+            typelist = pa_classify_typeset_string(u, ts);
             ret = pa_proplist_sets(sink->proplist,
-                                   PA_PROP_POLICY_DEVTYPELIST, buf);
+                                   PA_PROP_POLICY_DEVTYPELIST, typelist);
 
             if (ret < 0) {
                 pa_log("failed to set property '%s' on sink '%s'",
@@ -450,20 +441,15 @@ static void handle_new_sink(struct userdata *u, struct pa_sink *sink)
             }
             else {
                 pa_log_debug("new sink '%s' (idx=%d) (type %s)",
-                             name, idx, buf);
-
-                ext = pa_xmalloc0(sizeof(struct pa_sink_ext));
-                pa_index_hash_add(u->hsnk, idx, ext);
+                             name, idx, typelist);
 
                 pa_policy_groupset_update_default_sink(u, PA_IDXSET_INVALID);
                 pa_policy_groupset_register_sink(u, sink);
 
-                len = pa_classify_sink(u, sink, PA_POLICY_DISABLE_NOTIFY,0,
-                                       buf, sizeof(buf));
-                if (len > 0) {
-                    pa_policy_send_device_state(u, PA_POLICY_CONNECTED, buf);
-                }
+                pa_policy_send_device_state(u, PA_POLICY_CONNECTED, ts);
             }
+
+            pa_xfree(typelist);
         }
     }
 }
@@ -471,16 +457,15 @@ static void handle_new_sink(struct userdata *u, struct pa_sink *sink)
 static void handle_removed_sink(struct userdata *u, struct pa_sink *sink)
 {
     const char          *name;
+    const char          *typelist;
     uint32_t             idx;
-    char                 buf[1024];
-    int                  len;
     struct pa_null_sink *ns;
     struct pa_sink_ext  *ext;
+    struct pa_classify_typeset *ts;
 
     if (sink && u) {
         name = pa_sink_ext_get_name(sink);
         idx  = sink->index;
-        len  = pa_classify_sink(u, sink, 0,0, buf, sizeof(buf));
         ns   = u->nullsink;
 
         if (ns->sink == sink) {
@@ -496,78 +481,56 @@ static void handle_removed_sink(struct userdata *u, struct pa_sink *sink)
         pa_policy_context_unregister(u, pa_policy_object_sink, name, sink,idx);
         pa_policy_activity_unregister(u, pa_policy_object_sink, name, sink,idx);
 
-        if (len <= 0)
+        pa_classify_unindex_sink(u, sink);
+
+        if ((ext = pa_index_hash_remove(u->hsnk, idx)) == NULL) {
+            pa_log("no extension found for sink '%s' (idx=%u)",name,idx);
+            ts = pa_classify_sink(u, sink);
+        }
+        else {
+            ts = ext->typeset;
+            pa_xfree(ext->overridden_port);
+            pa_xfree(ext);
+        }
+
+        if (pa_classify_typeset_empty(ts))
             pa_log_debug("remove sink '%s' (idx=%u)", name, idx);
         else {
-            pa_log_debug("remove sink '%s' (idx=%d, type=%s)", name,idx, buf);
+            if (!(typelist = pa_proplist_gets(sink->proplist,
+                                              PA_PROP_POLICY_DEVTYPELIST)))
+                typelist = "";
+
+            pa_log_debug("remove sink '%s' (idx=%d, type=%s)",
+                         name, idx, typelist);
 
             pa_policy_groupset_update_default_sink(u, idx);
             pa_policy_groupset_unregister_sink(u, idx);
 
-            if ((ext = pa_index_hash_remove(u->hsnk, idx)) == NULL)
-                pa_log("no extension found for sink '%s' (idx=%u)",name,idx);
-            else {
-                pa_xfree(ext->overridden_port);
-                pa_xfree(ext);
-            }
-
-            len = pa_classify_sink(u, sink, PA_POLICY_DISABLE_NOTIFY,0,
-                                   buf, sizeof(buf));
-            
-            if (len > 0) {
-                pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, buf);
-            }
+            pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, ts);
         }
+
+        pa_classify_typeset_free(ts);
     }
 }
 
 void pa_policy_send_device_state(struct userdata *u, const char *state,
-                                 char *typelist)
+                                 struct pa_classify_typeset *typeset)
 {
 #define MAX_TYPE 256
 
     const char *types[MAX_TYPE];
     int   ntype;
-    char  buf[1024];
-    char *p, *q, c;
-
-    if (typelist && typelist[0]) {
-
-        ntype = 0;
-        
-        p = typelist - 1;
-        q = buf;
-        
-        do {
-            p++;
-            
-            if (ntype < MAX_TYPE)
-                types[ntype] = q;
-            else {
-                pa_log("%s() list overflow", __FUNCTION__);
-                return;
-            }
-            
-            while ((c = *p) != ' ' && c != '\0') {
-                if (q < buf + sizeof(buf)-1)
-                    *q++ = *p++;
-                else {
-                    pa_log("%s() buffer overflow", __FUNCTION__);
-                    return;
-                }
-            }
-            *q++ = '\0';
-            ntype++;
-            
-        } while (*p);
-        
-        pa_policy_dbusif_send_device_state(u, state, types, ntype);
+
+    if (typeset) {
+        ntype = pa_classify_typeset_names(u, typeset, true, types, MAX_TYPE);
+
+        if (ntype > 0)
+            pa_policy_dbusif_send_device_state(u, state, types, ntype);
     }
 
 #undef MAX_TYPE
 }
 
-
 /*
  * Local Variables:
  * c-basic-offset: 4
@@ -4,6 +4,7 @@
 #include "userdata.h"
 
 struct pa_sink;
+struct pa_classify_typeset;
 
 struct pa_null_sink {
     char            *name;
@@ -16,8 +17,8 @@ struct pa_sink_evsubscr {
 };
 
 struct pa_sink_ext {
-    char *overridden_port;
-    int   need_volume_setting;
+    char                       *overridden_port;
+    struct pa_classify_typeset *typeset;
 };
 
 struct pa_null_sink *pa_sink_ext_init_null_sink(const char *);
@@ -28,11 +29,11 @@ void  pa_sink_ext_discover(struct userdata *);
 struct pa_sink_ext *pa_sink_ext_lookup(struct userdata *, struct pa_sink *);
 const char *pa_sink_ext_get_name(struct pa_sink *);
 int pa_sink_ext_set_ports(struct userdata *, const char *);
-void pa_sink_ext_set_volumes(struct userdata *);
 void pa_sink_ext_override_port(struct userdata *, struct pa_sink *, char *);
 void pa_sink_ext_restore_port(struct userdata *, struct pa_sink *);
 
-void pa_policy_send_device_state(struct userdata *, const char *, char *);
+void pa_policy_send_device_state(struct userdata *, const char *,
+                                 struct pa_classify_typeset *);
 
 #endif /* foosinkextfoo */
 
@@ -21,12 +21,19 @@
 #include "sink-ext.h"
 #include "classify.h"
 #include "context.h"
+#include "volume-factor.h"
+
+/* key of the policy limit among the volume factors of a stream */
+#define VOLUME_FACTOR_KEY "module-policy-enforcement"
+/* key of the zero factor that mutes a stream by volume */
+#define MUTE_FACTOR_KEY   "module-policy-enforcement-mute"
 
 /* hooks */
 static pa_hook_result_t sink_input_neew(void *, void *, void *);
 static pa_hook_result_t sink_input_fixate(void *, void *, void *);
 static pa_hook_result_t sink_input_put(void *, void *, void *);
 static pa_hook_result_t sink_input_unlink(void *, void *, void *);
+static pa_hook_result_t sink_input_move_finish(void *, void *, void *);
 static pa_hook_result_t sink_input_state_changed(pa_core *c, pa_sink_input *si, struct userdata *u);
 #if (PULSEAUDIO_VERSION == 6)
 static pa_hook_result_t sink_input_mute_changed(pa_core *c, pa_sink_input *si, struct userdata *u);
@@ -40,6 +47,7 @@ static void handle_sink_input_fixate(struct userdata *u, pa_sink_input_new_data
 static void handle_removed_sink_input(struct userdata *,
                                       struct pa_sink_input *);
 static uint32_t update_state_flag(uint32_t flags, enum pa_sink_input_ext_state flag, bool set);
+static void sync_factor_mute(struct pa_sink_input *, bool);
 
 struct pa_sinp_evsubscr *pa_sink_input_ext_subscription(struct userdata *u)
 {
@@ -50,6 +58,7 @@ struct pa_sinp_evsubscr *pa_sink_input_ext_subscription(struct userdata *u)
     pa_hook_slot            *fixate;
     pa_hook_slot            *put;
     pa_hook_slot            *unlink;
+    pa_hook_slot            *move_finish;
 
     pa_assert(u);
     pa_assert_se((core = u->core));
@@ -65,6 +74,9 @@ struct pa_sinp_evsubscr *pa_sink_input_ext_subscription(struct userdata *u)
                              PA_HOOK_LATE, sink_input_put, (void *)u);
     unlink = pa_hook_connect(hooks + PA_CORE_HOOK_SINK_INPUT_UNLINK,
                              PA_HOOK_LATE, sink_input_unlink, (void *)u);
+    move_finish = pa_hook_connect(hooks + PA_CORE_HOOK_SINK_INPUT_MOVE_FINISH,
+                                  PA_HOOK_LATE, sink_input_move_finish,
+                                  (void *)u);
 
 
     subscr = pa_xnew0(struct pa_sinp_evsubscr, 1);
@@ -73,6 +85,7 @@ struct pa_sinp_evsubscr *pa_sink_input_ext_subscription(struct userdata *u)
     subscr->fixate = fixate;
     subscr->put    = put;
     subscr->unlink = unlink;
+    subscr->move_finish = move_finish;
     /* cork and mute state hooks are dynamically set when corking or muting
      * is done for the first time. This way if corking or muting is never
      * used, we don't need to set up the state hooks. */
@@ -89,6 +102,7 @@ void  pa_sink_input_ext_subscription_free(struct pa_sinp_evsubscr *subscr)
         pa_hook_slot_free(subscr->fixate);
         pa_hook_slot_free(subscr->put);
         pa_hook_slot_free(subscr->unlink);
+        pa_hook_slot_free(subscr->move_finish);
         if (subscr->cork_state)
             pa_hook_slot_free(subscr->cork_state);
         if (subscr->mute_state)
@@ -210,24 +224,22 @@ const char *pa_sink_input_ext_get_name(struct pa_sink_input *sinp)
 }
 
 
+/*
+ * The limit lives in a keyed entry of the stream's volume factors, so
+ * other modules' factors are left alone and the core recomputes the
+ * soft volume itself; no full sink volume recalculation is needed even
+ * with flat volumes.
+ */
 int pa_sink_input_ext_set_volume_limit(struct userdata *u,
                                        struct pa_sink_input *sinp,
                                        pa_volume_t limit)
 {
-    pa_sink     *sink;
-    int          retval;
-    uint64_t     limit64;
-    pa_volume_t  value;
+    struct pa_sink_input_ext *ext;
     pa_cvolume  *factor;
-    pa_cvolume  *real;
-    int          changed;
-    int          i;
 
     pa_assert(u);
     pa_assert(sinp);
-    pa_assert_se((sink = sinp->sink));
-
-    retval = 0;
+    pa_assert(sinp->sink);
 
     if (limit == 0)
         pa_sink_input_ext_mute(u, sinp, true);
@@ -237,46 +249,68 @@ int pa_sink_input_ext_set_volume_limit(struct userdata *u,
         if (limit > PA_VOLUME_NORM)
             limit = PA_VOLUME_NORM;
 
-        factor  = &sinp->volume_factor;
-        real    = &sinp->real_ratio;
-        limit64 = (uint64_t)limit * (uint64_t)PA_VOLUME_NORM;
-        changed = false;
+        pa_assert_se((ext = pa_sink_input_ext_lookup(u, sinp)));
 
-        if (real->channels != factor->channels) {
-            pa_log_debug("channel number mismatch");
-            retval = -1;
-        }
-        else {
-            for (i = 0;   i < factor->channels;   i++) {
-                if (limit < real->values[i])
-                    value = limit64 / (uint64_t)real->values[i];
-                else
-                    value = PA_VOLUME_NORM;
-
-                if (value != factor->values[i]) {
-                    changed = 1;
-                    factor->values[i] = value;
-                }
-            }
+        factor = &ext->local.volume_factor;
 
-            if (changed) {
-                if (pa_sink_flat_volume_enabled(sink))
-                    retval = 1;
-                else {
-                    pa_sw_cvolume_multiply(&sinp->soft_volume, real, factor);
-                    pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sinp),
-                                      PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME,
-                                      NULL, 0, NULL);
-                }
-            }
+        /* an unchanged limit costs nothing */
+        if (pa_volume_factor_limit(factor, &sinp->real_ratio, limit)) {
+            pa_sink_input_remove_volume_factor(sinp, VOLUME_FACTOR_KEY);
+
+            if (!pa_cvolume_is_norm(factor))
+                pa_sink_input_add_volume_factor(sinp,VOLUME_FACTOR_KEY,factor);
         }
     }
 
-    return retval;
+    return 0;
+}
+
+/*
+ * Mute or unmute a stream with a zero volume factor. The stream stays
+ * on its sink and the user's mute state is not touched. A stream that
+ * is being moved has no sink to talk to; the request is remembered and
+ * applied when the move finishes.
+ */
+int pa_sink_input_ext_set_factor_mute(struct userdata *u,
+                                      struct pa_sink_input *sinp,
+                                      bool mute)
+{
+    struct pa_sink_input_ext *ext;
+
+    pa_assert(u);
+    pa_assert(sinp);
+
+    if (!(ext = pa_sink_input_ext_lookup(u, sinp)))
+        return -1;
+
+    ext->local.factor_mute = mute;
+
+    if (sinp->sink)
+        sync_factor_mute(sinp, mute);
+
+    return 0;
+}
+
+/*
+ * The entry itself tells whether the stream is muted: the fixate hook
+ * may have installed it before the stream had an extension.
+ */
+static void sync_factor_mute(struct pa_sink_input *sinp, bool mute)
+{
+    pa_cvolume zero;
+    bool       muted;
+
+    muted = pa_hashmap_get(sinp->volume_factor_items, MUTE_FACTOR_KEY) != NULL;
+
+    if (mute && !muted) {
+        pa_cvolume_set(&zero, sinp->sample_spec.channels, PA_VOLUME_MUTED);
+        pa_sink_input_add_volume_factor(sinp, MUTE_FACTOR_KEY, &zero);
+    }
+    else if (!mute && muted)
+        pa_sink_input_remove_volume_factor(sinp, MUTE_FACTOR_KEY);
 }
 
 
- 
 static pa_hook_result_t sink_input_neew(void *hook_data, void *call_data,
                                        void *slot_data)
 {
@@ -332,7 +366,9 @@ static pa_hook_result_t sink_input_neew(void *hook_data, void *call_data,
             local_route  = flags & PA_POLICY_LOCAL_ROUTE;
             local_volume = flags & PA_POLICY_LOCAL_VOLMAX;
 
-            if (group->mutebyrt && !local_route) {
+            if (group->mutebyrt && !local_route &&
+                !(group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME))
+            {
                 sink_name = u->nullsink->name;
 
                 pa_log_debug("force stream '%s'/'%s' to sink '%s' due to "
@@ -413,6 +449,24 @@ static pa_hook_result_t sink_input_unlink(void *hook_data, void *call_data,
     return PA_HOOK_OK;
 }
 
+static pa_hook_result_t sink_input_move_finish(void *hook_data,
+                                               void *call_data,
+                                               void *slot_data)
+{
+    struct pa_sink_input     *sinp = (struct pa_sink_input *)call_data;
+    struct userdata          *u    = (struct userdata *)slot_data;
+    struct pa_sink_input_ext *ext;
+
+    pa_assert(u);
+    pa_assert(sinp);
+
+    /* catch up with a factor mute or unmute that came in mid-move */
+    if ((ext = pa_sink_input_ext_lookup(u, sinp)))
+        sync_factor_mute(sinp, ext->local.factor_mute);
+
+    return PA_HOOK_OK;
+}
+
 static struct pa_policy_group* get_group(struct userdata *u, const char *group_name, pa_proplist *sinp_proplist, uint32_t *flags_ret)
 {
     struct pa_policy_group *group = NULL;
@@ -547,8 +601,7 @@ bool pa_sink_input_ext_cork(struct userdata *u, pa_sink_input *si, bool cork)
 
     if (!u->ssi->cork_state) {
         /* Check current sink input state and enable corking state following. */
-        u->ssi->cork_state = pa_hook_connect(&u->core->hooks[PA_CORE_HOOK_SINK_INPUT_STATE_CHANGED],
-                                             PA_HOOK_EARLY, (pa_hook_cb_t) sink_input_state_changed, (void *) u);
+        pa_sink_input_ext_follow_state(u);
         ext->local.cork_state = update_state_flag(ext->local.cork_state,
                                                   PA_SINK_INPUT_EXT_STATE_USER,
                                                   sink_input_corked);
@@ -586,6 +639,11 @@ static pa_hook_result_t sink_input_state_changed(pa_core *c, pa_sink_input *sinp
     pa_assert(u);
 
     pa_assert_se((ext = pa_sink_input_ext_lookup(u, sinp)));
+
+    /* streams of lazy groups may have missed changes while corked */
+    if (PA_SINK_INPUT_CORKED != pa_sink_input_get_state(sinp))
+        pa_policy_group_catch_up_sink_input(u, sinp);
+
     if (ext->local.ignore_cork_state_change) {
         ext->local.ignore_cork_state_change = false;
         return PA_HOOK_OK;
@@ -601,6 +659,17 @@ static pa_hook_result_t sink_input_state_changed(pa_core *c, pa_sink_input *sinp
     return PA_HOOK_OK;
 }
 
+void pa_sink_input_ext_follow_state(struct userdata *u)
+{
+    pa_assert(u);
+    pa_assert(u->ssi);
+
+    if (!u->ssi->cork_state) {
+        u->ssi->cork_state = pa_hook_connect(&u->core->hooks[PA_CORE_HOOK_SINK_INPUT_STATE_CHANGED],
+                                             PA_HOOK_EARLY, (pa_hook_cb_t) sink_input_state_changed, (void *) u);
+    }
+}
+
 bool pa_sink_input_ext_mute(struct userdata *u, pa_sink_input *si, bool mute)
 {
 #if (PULSEAUDIO_VERSION == 5)
@@ -694,6 +763,7 @@ static void handle_sink_input_fixate(struct userdata *u,
     const char *sinp_name;
     int         group_volume;
     pa_cvolume  group_limit;
+    pa_cvolume  group_mute;
     uint32_t flags;
 
     pa_assert(u);
@@ -716,44 +786,65 @@ static void handle_sink_input_fixate(struct userdata *u,
                        sinp_data->channel_map.channels,
                        group->limit);
 
-        pa_sink_input_new_data_add_volume_factor(sinp_data, sinp_name, &group_limit);
+        pa_sink_input_new_data_add_volume_factor(sinp_data, VOLUME_FACTOR_KEY,
+                                                 &group_limit);
+    }
+
+    /* like the limit, so that the stream never plays unmuted */
+    if (group->mutebyrt && !(flags & PA_POLICY_LOCAL_ROUTE) &&
+        (group->flags & PA_POLICY_GROUP_FLAG_MUTE_BY_VOLUME))
+    {
+        pa_log_debug("stream '%s'/'%s' starts muted by volume",
+                     group->name, sinp_name);
+
+        pa_cvolume_set(&group_mute, sinp_data->channel_map.channels,
+                       PA_VOLUME_MUTED);
+
+        pa_sink_input_new_data_add_volume_factor(sinp_data, MUTE_FACTOR_KEY,
+                                                 &group_mute);
     }
 }
 
 static void handle_removed_sink_input(struct userdata      *u,
                                       struct pa_sink_input *sinp)
 {
-    struct pa_policy_group *group = NULL;
+    struct pa_policy_group *group;
     struct pa_sink_input_ext *ext;
     struct pa_sink *sink;
     uint32_t        idx;
     const char     *snam;
-    uint32_t        flags;
 
     if (sinp && u) {
         idx  = sinp->index;
         sink = sinp->sink;
         snam = sink_input_ext_get_name(sinp->proplist);
-        pa_assert_se((group = get_group_or_classify(u, sinp, &flags)));
 
-        if (flags & PA_POLICY_LOCAL_ROUTE)
+        /* the group and the local policies were stored when the sink input
+           was put; no need to classify a stream that is going away */
+        if ((ext = pa_sink_input_ext_lookup(u, sinp)) == NULL) {
+            pa_log("no extension found for sink-input '%s' (idx=%u)",snam,idx);
+            pa_policy_context_unregister(u, pa_policy_object_sink_input,
+                                         snam, sinp, sinp->index);
+            return;
+        }
+
+        group = ext->member.group;
+
+        if (ext->local.route)
             pa_sink_ext_restore_port(u, sink);
 
-        if (flags & PA_POLICY_LOCAL_MUTE)
+        if (ext->local.mute)
             pa_policy_groupset_restore_volume(u, sink);
-            
+
         pa_policy_context_unregister(u, pa_policy_object_sink_input,
                                      snam, sinp, sinp->index);
-        pa_policy_group_remove_sink_input(u, sinp->index);
+        pa_policy_group_remove_sink_input(u, sinp);
 
-        if ((ext = pa_index_hash_remove(u->hsi, idx)) == NULL)
-            pa_log("no extension found for sink-input '%s' (idx=%u)",snam,idx);
-        else {
-            pa_xfree(ext);
-        }
+        pa_index_hash_remove(u->hsi, idx);
+        pa_xfree(ext);
 
         pa_log_debug("removed sink_input '%s' (idx=%d) (group=%s)",
-                     snam, idx, group->name);
+                     snam, idx, group ? group->name : "<none>");
     }
 }
 
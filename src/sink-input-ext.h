@@ -11,12 +11,14 @@
 
 
 #include "userdata.h"
+#include "policy-group.h"
 
 struct pa_sinp_evsubscr {
     pa_hook_slot    *neew;
     pa_hook_slot    *fixate;
     pa_hook_slot    *put;
     pa_hook_slot    *unlink;
+    pa_hook_slot    *move_finish;
     pa_hook_slot    *cork_state;
     pa_hook_slot    *mute_state;
 };
@@ -35,7 +37,10 @@ struct pa_sink_input_ext {
         bool ignore_cork_state_change;
         uint32_t mute_state;
         bool ignore_mute_state_change;
+        pa_cvolume volume_factor; /* our entry in the keyed factors */
+        bool factor_mute;         /* muted by a zero volume factor */
     }                local;     /* local policies */
+    struct pa_sink_input_list member; /* membership of the policy group */
 };
 
 struct pa_sinp_evsubscr *pa_sink_input_ext_subscription(struct userdata *);
@@ -49,7 +54,9 @@ int   pa_sink_input_ext_set_policy_group(struct pa_sink_input *, const char *);
 const char *pa_sink_input_ext_get_policy_group(struct pa_sink_input *);
 const char *pa_sink_input_ext_get_name(struct pa_sink_input *);
 int   pa_sink_input_ext_set_volume_limit(struct userdata *u, struct pa_sink_input *, pa_volume_t);
+int   pa_sink_input_ext_set_factor_mute(struct userdata *u, struct pa_sink_input *, bool);
 bool pa_sink_input_ext_cork(struct userdata *u, pa_sink_input *si, bool cork);
+void pa_sink_input_ext_follow_state(struct userdata *u);
 bool pa_sink_input_ext_mute(struct userdata *u, pa_sink_input *si, bool mute);
 
 #endif
@@ -0,0 +1,138 @@
+/*
+ * Measures how long a volume_limit action blocks the main loop on the
+ * IO thread. Every soft volume change of a linked stream is a
+ * synchronous pa_asyncmsgq_send() to the sink's IO thread; this times
+ * those round trips for one action over a sink with many streams:
+ *
+ *   per stream   one message per stream (a plain soft volume update)
+ *   keyed factor two messages per stream (remove and re-add of the
+ *                keyed volume factor, what the limit costs now)
+ *   per sink     one message for all streams of the sink (the batched
+ *                path that was dropped for lack of a public core API)
+ *
+ * Only the message round trip is modelled. The IO thread does no mixing
+ * and the factor arithmetic is not included; both are the same for all
+ * three.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulsecore/asyncmsgq.h>
+#include <pulsecore/thread.h>
+
+#define STREAMS  40
+#define ACTIONS  2000
+
+enum {
+    MESSAGE_SET_SOFT_VOLUME,
+    MESSAGE_QUIT
+};
+
+struct bench {
+    const char *name;
+    int         messages;     /* messages per action */
+};
+
+static void      io_thread(void *);
+static pa_usec_t run(pa_asyncmsgq *, int, pa_usec_t *);
+
+
+int main(int argc, char **argv)
+{
+    static const struct bench benches[] = {
+        { "per stream"  , STREAMS     },
+        { "keyed factor", STREAMS * 2 },
+        { "per sink"    , 1           },
+    };
+
+    pa_asyncmsgq *q;
+    pa_thread    *thread;
+    pa_usec_t     total;
+    pa_usec_t     max;
+    unsigned      i;
+
+    (void)argc;
+    (void)argv;
+
+    q = pa_asyncmsgq_new(0);
+    thread = pa_thread_new("soft-volume-io", io_thread, q);
+
+    /* warm up the queue and the thread */
+    run(q, STREAMS, &max);
+
+    printf("volume_limit over %d streams, %d actions\n", STREAMS, ACTIONS);
+
+    for (i = 0;  i < sizeof(benches)/sizeof(benches[0]);  i++) {
+        total = run(q, benches[i].messages, &max);
+
+        printf("  %-12s %3d messages: %8.1f us mean, %6llu us max "
+               "main loop blocking per action\n",
+               benches[i].name, benches[i].messages,
+               (double)total / ACTIONS, (unsigned long long)max);
+    }
+
+    pa_asyncmsgq_send(q, NULL, MESSAGE_QUIT, NULL, 0, NULL);
+    pa_thread_free(thread);
+    pa_asyncmsgq_unref(q);
+
+    return EXIT_SUCCESS;
+}
+
+static void io_thread(void *userdata)
+{
+    pa_asyncmsgq *q = userdata;
+    int           code;
+    int           quit = 0;
+
+    while (!quit) {
+        if (pa_asyncmsgq_get(q, NULL, &code, NULL, NULL, NULL, true) < 0)
+            continue;
+
+        quit = (code == MESSAGE_QUIT);
+
+        pa_asyncmsgq_done(q, 0);
+    }
+}
+
+/* returns the total blocking time of all actions; max gets the worst */
+static pa_usec_t run(pa_asyncmsgq *q, int messages, pa_usec_t *max)
+{
+    pa_usec_t total = 0;
+    pa_usec_t start;
+    pa_usec_t blocked;
+    int       action;
+    int       i;
+
+    *max = 0;
+
+    for (action = 0;  action < ACTIONS;  action++) {
+        start = pa_rtclock_now();
+
+        for (i = 0;  i < messages;  i++)
+            pa_asyncmsgq_send(q, NULL, MESSAGE_SET_SOFT_VOLUME, NULL, 0, NULL);
+
+        blocked = pa_rtclock_now() - start;
+
+        total += blocked;
+
+        if (blocked > *max)
+            *max = blocked;
+    }
+
+    return total;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
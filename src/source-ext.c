@@ -13,6 +13,7 @@
 #include <pulsecore/source.h>
 
 #include "source-ext.h"
+#include "index-hash.h"
 #include "classify.h"
 #include "context.h"
 #include "policy-group.h"
@@ -82,6 +83,19 @@ void pa_source_ext_discover(struct userdata *u)
         handle_new_source(u, source);
 }
 
+struct pa_source_ext *pa_source_ext_lookup(struct userdata *u,
+                                           struct pa_source *source)
+{
+    struct pa_source_ext *ext;
+
+    pa_assert(u);
+    pa_assert(source);
+
+    ext = pa_index_hash_lookup(u->hsrc, source->index);
+
+    return ext;
+}
+
 
 const char *pa_source_ext_get_name(struct pa_source *source)
 {
@@ -90,39 +104,47 @@ const char *pa_source_ext_get_name(struct pa_source *source)
 
 int pa_source_ext_set_mute(struct userdata *u, const char *type, int mute)
 {
-    void              *state = NULL;
-    pa_idxset         *idxset;
+    pa_idxset         *sources;
     struct pa_source  *source;
+    struct pa_source  *first;
     const char        *name;
+    uint32_t           idx;
     bool          current_mute;
 
     pa_assert(u);
     pa_assert(type);
     pa_assert(u->core);
-    pa_assert_se((idxset = u->core->sources));
 
-    while ((source = pa_idxset_iterate(idxset, &state, NULL)) != NULL) {
-        if (pa_classify_is_source_typeof(u, source, type, NULL)) {
-            name = pa_source_ext_get_name(source);
-            current_mute = pa_source_get_mute(source, 0);
+    if (!(sources = pa_classify_type_members(u, type,
+                                             pa_classify_member_source)))
+        return -1;
 
-            if ((current_mute && mute) || (!current_mute && !mute)) {
-                pa_log_debug("%s() source '%s' type '%s' is already %smuted",
-                             __FUNCTION__, name, type, mute ? "" : "un");
-            }
-            else {
-                pa_log_debug("%s() %smute source '%s' type '%s'",
-                             __FUNCTION__, mute ? "" : "un", name, type);
+    /* the first one in the core's order, i.e. the lowest index */
+    first = NULL;
 
-                pa_source_set_mute(source, mute, true);
-            }
+    PA_IDXSET_FOREACH(source, sources, idx) {
+        if (!first || source->index < first->index)
+            first = source;
+    }
 
-            return 0;
-        }
+    if ((source = first) == NULL)
+        return -1;
+
+    name = pa_source_ext_get_name(source);
+    current_mute = pa_source_get_mute(source, 0);
+
+    if ((current_mute && mute) || (!current_mute && !mute)) {
+        pa_log_debug("%s() source '%s' type '%s' is already %smuted",
+                     __FUNCTION__, name, type, mute ? "" : "un");
     }
+    else {
+        pa_log_debug("%s() %smute source '%s' type '%s'",
+                     __FUNCTION__, mute ? "" : "un", name, type);
 
+        pa_source_set_mute(source, mute, true);
+    }
 
-    return -1;
+    return 0;
 }
 
 int pa_source_ext_set_ports(struct userdata *u, const char *type)
@@ -130,12 +152,17 @@ int pa_source_ext_set_ports(struct userdata *u, const char *type)
     int ret = 0;
     pa_source *source;
     struct pa_classify_device_data *data;
+    pa_idxset *sources;
     uint32_t idx;
 
     pa_assert(u);
     pa_assert(u->core);
 
-    PA_IDXSET_FOREACH(source, u->core->sources, idx) {
+    if (!(sources = pa_classify_type_members(u, type,
+                                             pa_classify_member_port_source)))
+        return ret;
+
+    PA_IDXSET_FOREACH(source, sources, idx) {
         /* Check whether the port of this source should be changed. */
         if (pa_classify_is_port_source_typeof(u, source, type, &data)) {
             struct pa_classify_port_entry *port_entry;
@@ -201,21 +228,27 @@ static void handle_new_source(struct userdata *u, struct pa_source *source)
 {
     const char      *name;
     uint32_t         idx;
-    char             buf[1024];
-    int              len;
+    char            *typelist;
     int              ret;
+    struct pa_source_ext       *ext;
+    struct pa_classify_typeset *ts;
 
     if (source && u) {
         name = pa_source_ext_get_name(source);
         idx  = source->index;
-        len  = pa_classify_source(u, source, 0,0, buf, sizeof(buf));
+        ts   = pa_classify_source(u, source);
 
+        ext = pa_xnew0(struct pa_source_ext, 1);
+        ext->typeset = ts;
+        pa_index_hash_add(u->hsrc, idx, ext);
+        pa_classify_index_source(u, source, ts);
 
-        if (len <= 0)
-                pa_log_debug("new source '%s' (idx=%d)", name, idx);
+        if (pa_classify_typeset_empty(ts))
+            pa_log_debug("new source '%s' (idx=%d)", name, idx);
         else {
+            typelist = pa_classify_typeset_string(u, ts);
             ret = pa_proplist_sets(source->proplist,
-                                   PA_PROP_POLICY_DEVTYPELIST, buf);
+                                   PA_PROP_POLICY_DEVTYPELIST, typelist);
 
             pa_policy_context_register(u,pa_policy_object_source,name,source);
 
@@ -225,18 +258,16 @@ static void handle_new_source(struct userdata *u, struct pa_source *source)
             }
             else {
                 pa_log_debug("new source '%s' (idx=%d type %s)",
-                             name, idx, buf);
+                             name, idx, typelist);
 #if 0
                 pa_policy_groupset_update_default_source(u, PA_IDXSET_INVALID);
 #endif
                 pa_policy_groupset_register_source(u, source);
 
-                len = pa_classify_source(u, source, PA_POLICY_DISABLE_NOTIFY,0,
-                                         buf, sizeof(buf));
-                if (len > 0) {
-                    pa_policy_send_device_state(u, PA_POLICY_CONNECTED, buf);
-                }
+                pa_policy_send_device_state(u, PA_POLICY_CONNECTED, ts);
             }
+
+            pa_xfree(typelist);
         }
     }
 }
@@ -244,40 +275,50 @@ static void handle_new_source(struct userdata *u, struct pa_source *source)
 static void handle_removed_source(struct userdata *u, struct pa_source *source)
 {
     const char      *name;
+    const char      *typelist;
     uint32_t         idx;
-    char             buf[1024];
-    int              len;
+    struct pa_source_ext       *ext;
+    struct pa_classify_typeset *ts;
 
     if (source && u) {
         name = pa_source_ext_get_name(source);
         idx  = source->index;
-        len  = pa_classify_source(u, source, 0,0, buf, sizeof(buf));
 
         pa_policy_context_unregister(u, pa_policy_object_source,
                                      name, source, idx);
 
-        if (len <= 0)
+        pa_classify_unindex_source(u, source);
+
+        if ((ext = pa_index_hash_remove(u->hsrc, idx)) == NULL)
+            ts = pa_classify_source(u, source);
+        else {
+            ts = ext->typeset;
+            pa_xfree(ext);
+        }
+
+        if (pa_classify_typeset_empty(ts))
             pa_log_debug("remove source '%s' (idx=%d)", name, idx);
         else {
-            pa_log_debug("remove source '%s' (idx=%d, type=%s)", name,idx,buf);
-            
+            if (!(typelist = pa_proplist_gets(source->proplist,
+                                              PA_PROP_POLICY_DEVTYPELIST)))
+                typelist = "";
+
+            pa_log_debug("remove source '%s' (idx=%d, type=%s)",
+                         name, idx, typelist);
 #if 0
             pa_policy_groupset_update_default_source(u, idx);
 #endif
             pa_policy_groupset_unregister_source(u, idx);
 
-            len = pa_classify_source(u, source, PA_POLICY_DISABLE_NOTIFY,0,
-                                     buf, sizeof(buf));
-            if (len > 0) {
-                pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, buf);
-            }
+            pa_policy_send_device_state(u, PA_POLICY_DISCONNECTED, ts);
         }
+
+        pa_classify_typeset_free(ts);
     }
 }
 
 
 
-
 /*
  * Local Variables:
  * c-basic-offset: 4
@@ -12,6 +12,7 @@
 #include <pulsecore/sink.h>
 #include <pulsecore/sink-input.h>
 
+#include "index-hash.h"
 #include "policy-group.h"
 #include "source-ext.h"
 #include "source-output-ext.h"
@@ -86,6 +87,19 @@ void pa_source_output_ext_discover(struct userdata *u)
         handle_new_source_output(u, sout);
 }
 
+struct pa_source_output_ext *pa_source_output_ext_lookup(struct userdata *u,
+                                                   struct pa_source_output *sout)
+{
+    struct pa_source_output_ext *ext;
+
+    pa_assert(u);
+    pa_assert(sout);
+
+    ext = pa_index_hash_lookup(u->hso, sout->index);
+
+    return ext;
+}
+
 int pa_source_output_ext_set_policy_group(struct pa_source_output *sout,
                                           const char *group)
 {
@@ -195,6 +209,7 @@ static pa_hook_result_t source_output_unlink(void *hook_data, void *call_data,
 static void handle_new_source_output(struct userdata         *u,
                                      struct pa_source_output *sout)
 {
+    struct pa_source_output_ext *ext;
     const char *snam;
     const char *gnam;
 
@@ -202,6 +217,9 @@ static void handle_new_source_output(struct userdata         *u,
         snam = pa_source_output_ext_get_name(sout);
         gnam = pa_classify_source_output(u, sout);
 
+        ext = pa_xnew0(struct pa_source_output_ext, 1);
+        pa_index_hash_add(u->hso, sout->index, ext);
+
         pa_policy_context_register(u,pa_policy_object_source_output,snam,sout);
         pa_policy_group_insert_source_output(u, gnam, sout);
 
@@ -214,19 +232,31 @@ static void handle_new_source_output(struct userdata         *u,
 static void handle_removed_source_output(struct userdata         *u,
                                          struct pa_source_output *sout)
 {
+    struct pa_source_output_ext *ext;
     const char *snam;
     const char *gnam;
 
     if (sout && u) {
         snam = pa_source_output_ext_get_name(sout);
-        gnam = pa_classify_source_output(u, sout);
 
         pa_policy_context_unregister(u, pa_policy_object_source_output,
                                      snam, sout, sout->index);
-        pa_policy_group_remove_source_output(u, sout->index);
+
+        if ((ext = pa_source_output_ext_lookup(u, sout)) == NULL) {
+            pa_log("no extension found for source-output '%s' (idx=%u)",
+                   snam, sout->index);
+            return;
+        }
+
+        gnam = ext->member.group ? ext->member.group->name : "<none>";
 
         pa_log_debug("removed source_output %s (idx=%d) (group=%s)",
                      snam, sout->index, gnam);
+
+        pa_policy_group_remove_source_output(u, sout);
+
+        pa_index_hash_remove(u->hso, sout->index);
+        pa_xfree(ext);
     }
 }
 
@@ -11,6 +11,7 @@
 
 
 #include "userdata.h"
+#include "policy-group.h"
 
 struct pa_sout_evsubscr {
     pa_hook_slot    *neew;
@@ -18,9 +19,15 @@ struct pa_sout_evsubscr {
     pa_hook_slot    *unlink;
 };
 
+struct pa_source_output_ext {
+    struct pa_source_output_list member; /* membership of the policy group */
+};
+
 struct pa_sout_evsubscr *pa_source_output_ext_subscription(struct userdata *);
 void  pa_source_output_ext_subscription_free(struct pa_sout_evsubscr *);
 void  pa_source_output_ext_discover(struct userdata *);
+struct pa_source_output_ext *pa_source_output_ext_lookup(struct userdata *,
+                                                   struct pa_source_output *);
 int   pa_source_output_ext_set_policy_group(struct pa_source_output *, const char *);
 const char *pa_source_output_ext_get_policy_group(struct pa_source_output *sout);
 const char *pa_source_output_ext_get_name(struct pa_source_output *sout);
@@ -36,7 +36,10 @@ struct userdata {
     pa_module                 *module;
     struct pa_null_sink       *nullsink;
     struct pa_index_hash      *hsnk;     /* sink index hash */
+    struct pa_index_hash      *hsrc;     /* source index hash */
+    struct pa_index_hash      *hcrd;     /* card index hash */
     struct pa_index_hash      *hsi;      /* sink input index hash */
+    struct pa_index_hash      *hso;      /* source output index hash */
     struct pa_client_evsubscr *scl;      /* client event susbscription */
     struct pa_sink_evsubscr   *ssnk;     /* sink event subscription */
     struct pa_source_evsubscr *ssrc;     /* source event subscription */
@@ -0,0 +1,124 @@
+/*
+ * Checks pa_volume_factor_limit() bit by bit against the per-channel
+ * expression it replaced.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "volume-factor.h"
+
+#define ROUNDS 100000
+
+static pa_volume_t reference(pa_volume_t, pa_volume_t);
+static pa_volume_t random_volume(void);
+
+
+int main(int argc, char **argv)
+{
+    static const pa_volume_t limits[] = {
+        1, PA_VOLUME_NORM / 2, PA_VOLUME_NORM - 1, PA_VOLUME_NORM
+    };
+
+    pa_cvolume  real;
+    pa_cvolume  factor;
+    pa_cvolume  again;
+    pa_volume_t limit;
+    int         failed = 0;
+    int         round;
+    int         i;
+
+    (void)argc;
+    (void)argv;
+
+    srand(1);
+
+    for (round = 0;   round < ROUNDS;   round++) {
+        real.channels = 1 + rand() % PA_CHANNELS_MAX;
+
+        for (i = 0;   i < real.channels;   i++) {
+            /* runs of equal ratios take the shortcut of the kernel */
+            if (i > 0 && rand() % 2)
+                real.values[i] = real.values[i-1];
+            else
+                real.values[i] = random_volume();
+        }
+
+        if (round < 4)
+            limit = limits[round];
+        else
+            limit = 1 + rand() % PA_VOLUME_NORM;
+
+        factor.channels = 0;
+        pa_volume_factor_limit(&factor, &real, limit);
+
+        for (i = 0;   i < real.channels;   i++) {
+            if (factor.values[i] != reference(limit, real.values[i])) {
+                printf("round %d: channel %d: limit %u ratio %u: "
+                       "%u instead of %u\n", round, i, limit, real.values[i],
+                       factor.values[i], reference(limit, real.values[i]));
+                failed++;
+            }
+        }
+
+        again = factor;
+
+        if (pa_volume_factor_limit(&again, &real, limit)) {
+            printf("round %d: an unchanged factor was reported changed\n",
+                   round);
+            failed++;
+        }
+
+        /* same channel count, one channel off: must be seen and fixed */
+        i = rand() % real.channels;
+        again.values[i] ^= 1;
+
+        if (!pa_volume_factor_limit(&again, &real, limit)) {
+            printf("round %d: a change of channel %d was not reported\n",
+                   round, i);
+            failed++;
+        }
+
+        if (memcmp(again.values, factor.values,
+                   real.channels * sizeof(pa_volume_t)))
+        {
+            printf("round %d: a changed factor was not recomputed\n", round);
+            failed++;
+        }
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static pa_volume_t reference(pa_volume_t limit, pa_volume_t real)
+{
+    uint64_t limit64 = (uint64_t)limit * (uint64_t)PA_VOLUME_NORM;
+
+    if (limit < real)
+        return limit64 / (uint64_t)real;
+
+    return PA_VOLUME_NORM;
+}
+
+static pa_volume_t random_volume(void)
+{
+    /* mostly below the norm, as ratios are; sometimes up to the max */
+    switch (rand() % 4) {
+    case 0:   return 1 + rand() % PA_VOLUME_MAX;
+    default:  return 1 + rand() % PA_VOLUME_NORM;
+    }
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
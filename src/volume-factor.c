@@ -0,0 +1,52 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "volume-factor.h"
+
+
+/*
+ * factor = limit * PA_VOLUME_NORM / real, per channel, clamped to
+ * PA_VOLUME_NORM. Returns true if any channel of the factor changed.
+ */
+int pa_volume_factor_limit(pa_cvolume       *factor,
+                           const pa_cvolume *real,
+                           pa_volume_t       limit)
+{
+    uint64_t    limit64 = (uint64_t)limit * (uint64_t)PA_VOLUME_NORM;
+    pa_volume_t value   = PA_VOLUME_NORM;
+    int         changed = false;
+    int         i;
+
+    if (factor->channels != real->channels) {
+        factor->channels = real->channels;
+        changed = true;
+    }
+
+    for (i = 0;   i < factor->channels;   i++) {
+        /* channels mostly share their ratio; divide once per run */
+        if (i == 0 || real->values[i] != real->values[i-1]) {
+            if (limit < real->values[i])
+                value = limit64 / (uint64_t)real->values[i];
+            else
+                value = PA_VOLUME_NORM;
+        }
+
+        changed |= (value != factor->values[i]);
+        factor->values[i] = value;
+    }
+
+    return changed;
+}
+
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */
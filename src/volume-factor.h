@@ -0,0 +1,17 @@
+#ifndef foovolumefactorfoo
+#define foovolumefactorfoo
+
+#include <pulse/volume.h>
+
+int pa_volume_factor_limit(pa_cvolume *, const pa_cvolume *, pa_volume_t);
+
+
+#endif /* foovolumefactorfoo */
+
+/*
+ * Local Variables:
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ *
+ */